@@ -0,0 +1,103 @@
+//==============================================================================================
+// SPI IP Testbench
+// MCP23S08 Behavioral Model (mcp23s08_model.v)
+// Deborah Jahaj and Nathan Fusselman
+
+//==============================================================================================
+// SPI mode 0,0 slave with the MCP23S08 register file:
+//   opcode 0100 A1 A0 R/W, register address, then data bytes
+//   IOCON.HAEN enables hardware addressing against HW_ADDR
+//   IOCON.SEQOP clear increments the address after every data byte
+//   GPIO reads return (pins ^ IPOL) on inputs and OLAT on outputs, writes go to OLAT
+// Interrupt logic (INTF, INTCAP, INT) is not modeled; those registers read as 0
+// A partial byte at CS deassertion is discarded
+
+//==============================================================================================
+
+module mcp23s08_model #(parameter [1:0] HW_ADDR = 2'b00)(
+	input cs_n, sclk, mosi,
+	input [7:0] pins,
+	output reg miso
+	);
+
+	parameter IODIR = 0, IPOL = 1, IOCON = 5, GPIO = 9, OLAT = 10;
+
+	reg [7:0] regs [0:10];
+	reg [7:0] shift, opcode, addr, rd;
+	reg [7:0] next_addr;
+	integer bits, i;
+
+	wire haen = regs[IOCON][3];
+	wire seqop = regs[IOCON][5];
+	wire selected = (opcode[7:3] == 5'b01000) & (~haen | (opcode[2:1] == HW_ADDR));
+	wire reading = opcode[0];
+	wire [7:0] shift_next = {shift[6:0], mosi};
+
+	function [7:0] value(input [7:0] a);
+		begin
+			if (a == GPIO)
+				value = ((pins ^ regs[IPOL]) & regs[IODIR]) | (regs[OLAT] & ~regs[IODIR]);
+			else if (a <= OLAT)
+				value = regs[a];
+			else
+				value = 8'h00;
+		end
+	endfunction
+
+	initial
+	begin
+		for (i = 0; i <= OLAT; i = i + 1)
+			regs[i] = 8'h00;
+		regs[IODIR] = 8'hFF;
+		bits = 0;
+		opcode = 8'h00;
+		miso = 1'b0;
+	end
+
+	// Sample MOSI on the rising edge
+	always @ (posedge sclk or posedge cs_n)
+	begin
+		if (cs_n)
+			bits <= 0;
+		else
+		begin
+			shift <= shift_next;
+			bits <= bits + 1;
+			if (bits % 8 == 7)
+			begin
+				if (bits == 7)
+					opcode <= shift_next;
+				else if (bits == 15)
+				begin
+					addr <= shift_next;
+					rd <= value(shift_next);
+				end
+				else
+				begin
+					if (selected & ~reading)
+					begin
+						if (addr == GPIO)
+							regs[OLAT] <= shift_next;
+						else if (addr <= OLAT && addr != 7 && addr != 8)
+							regs[addr] <= shift_next;
+					end
+					next_addr = seqop ? addr : ((addr >= OLAT) ? 8'h00 : addr + 1'b1);
+					addr <= next_addr;
+					rd <= value(next_addr);
+				end
+			end
+		end
+	end
+
+	// Drive MISO on the falling edge during the data bytes of a read
+	always @ (negedge sclk or posedge cs_n)
+	begin
+		if (cs_n)
+			miso <= 1'b0;
+		else if (bits >= 16 && selected && reading)
+			miso <= rd[7 - (bits % 8)];
+		else
+			miso <= 1'b0;
+	end
+
+endmodule
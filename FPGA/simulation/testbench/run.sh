@@ -0,0 +1,29 @@
+#!/bin/sh
+# SPI IP Testbench
+# Builds and runs tb_spi_dev against ../../spi_dev.v
+# Deborah Jahaj and Nathan Fusselman
+
+# Usage: ./run.sh [+quick] [+report=<file>]
+# Uses Icarus Verilog (iverilog/vvp) by default, or Verilator 5 with SIM=verilator
+# Exits non-zero if any check fails
+
+set -e
+cd "$(dirname "$0")"
+
+SOURCES="tb_spi_dev.v spi_mode_slave.v mcp23s08_model.v ../../spi_dev.v"
+mkdir -p build
+
+case "${SIM:-icarus}" in
+    icarus)
+        iverilog -g2012 -s tb_spi_dev -o build/tb_spi_dev $SOURCES
+        vvp -n build/tb_spi_dev "$@"
+        ;;
+    verilator)
+        verilator --binary --timing -Wno-fatal --top-module tb_spi_dev -Mdir build/verilator $SOURCES
+        build/verilator/Vtb_spi_dev "$@"
+        ;;
+    *)
+        echo "unknown SIM '$SIM' (icarus or verilator)" >&2
+        exit 1
+        ;;
+esac
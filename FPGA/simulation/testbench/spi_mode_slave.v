@@ -0,0 +1,85 @@
+//==============================================================================================
+// SPI IP Testbench
+// CPOL/CPHA SPI Slave Model (spi_mode_slave.v)
+// Deborah Jahaj and Nathan Fusselman
+
+//==============================================================================================
+// SPI slave of size bits per word (1-32, MSB first) in any of the four modes:
+//   CPHA 0  MISO driven at CS assertion and on trailing edges, MOSI sampled on leading edges
+//   CPHA 1  MISO driven on leading edges, MOSI sampled on trailing edges
+// A leading edge takes SCLK away from its idle level cpol
+// Received words are stored in rx_words (rx_count of them since clear); word k is
+// answered with response(k), kept in tx_words, so a wrong edge in the master shows
+// up on both lines
+// A partial word at CS deassertion is discarded
+
+//==============================================================================================
+
+module spi_mode_slave(
+	input cs_n, sclk, mosi, cpol, cpha, clear,
+	input [5:0] size,
+	output reg miso
+	);
+
+	reg [31:0] rx_words [0:63];
+	reg [31:0] tx_words [0:63];
+	reg [31:0] shift, word;
+	integer rx_count, bits;
+
+	function [31:0] response(input integer k);
+		begin
+			response = 32'h5A3C96E1 ^ (k * 32'h9E3779B9);
+		end
+	endfunction
+
+	task drive_bit;
+		begin
+			word = response(rx_count);
+			if (bits == 0)
+				tx_words[rx_count % 64] = word;
+			miso = word[size - 1 - bits];
+		end
+	endtask
+
+	initial
+	begin
+		rx_count = 0;
+		bits = 0;
+		shift = 32'b0;
+		miso = 1'b0;
+	end
+
+	always @ (posedge clear)
+		rx_count = 0;
+
+	always @ (cs_n)
+	begin
+		bits = 0;
+		shift = 32'b0;
+		if (cs_n === 1'b0 && !cpha)
+			drive_bit;
+	end
+
+	// Sampling edge is the leading edge for CPHA 0 and the trailing edge for CPHA 1
+	always @ (sclk)
+	begin
+		if (cs_n === 1'b0 && (sclk === 1'b0 || sclk === 1'b1))
+		begin
+			if ((sclk != cpol) ^ cpha)
+			begin
+				shift = {shift[30:0], mosi};
+				bits = bits + 1;
+				if (bits == size)
+				begin
+					rx_words[rx_count % 64] = shift;
+					rx_count = rx_count + 1;
+					bits = 0;
+					shift = 32'b0;
+				end
+			end
+			else
+				drive_bit;
+		end
+	end
+
+endmodule
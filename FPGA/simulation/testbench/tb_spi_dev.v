@@ -0,0 +1,430 @@
+//==============================================================================================
+// SPI IP Testbench
+// spi_dev Testbench (tb_spi_dev.v)
+// Deborah Jahaj and Nathan Fusselman
+
+//==============================================================================================
+// Drives spi_dev through its Avalon slave at 50 MHz with two SPI slaves on CS0:
+//   spi_mode_slave, set to the CPOL/CPHA under test, for the WORD_SIZE x MODE x BRD
+//   sweep, the CS-held frames and the FIFO checks
+//   mcp23s08_model for register write/read-back and CS-held frames
+// Modes are SPI mode numbers ({CPOL, CPHA}); configure writes them to MODE0 as
+// {CPOL, CPOL ^ CPHA}
+//
+// Sweep: for every mode, baud divisor and word size 1-32, WORDS words are queued
+// on CS0 with CS_AUTO and the SPI port is measured cycle by cycle:
+//   window_cycles   first Tx write to last Rx word stored
+//   sclk_util       data bit times (bits * divisor) / window
+//   avg/max_gap     SCLK leading-edge spacing beyond one period, per word boundary
+//   cs_setup/hold   clocks from CS assertion to the first leading edge and from
+//                   the last trailing edge to CS deassertion (minimum over frames)
+//   extra_edges     leading edges seen with CS asserted beyond WORDS * word size
+//   tx_ov/rx_ov     FIFO overflow flags after the run
+//   mosi_errors     words the slave sampled that differ from the words sent
+//   miso_errors     words received that differ from the slave's responses
+//
+// Plusargs:
+//   +report=<file>  CSV report (default spi_dev_report.csv)
+//   +quick          sweep word sizes 1, 8, 16, 24 and 32 only
+// The run ends with RESULT PASS or RESULT FAIL (and a non-zero exit status)
+
+//==============================================================================================
+
+`timescale 1ns/1ps
+
+module tb_spi_dev;
+
+	// Register numbers
+	localparam DATA_REG         = 5'd0;
+	localparam STATUS_REG       = 5'd1;
+	localparam CONTROL_REG      = 5'd2;
+	localparam BRD_REG          = 5'd3;
+	localparam FIFO_LEVEL_REG   = 5'd7;
+	localparam FRAME_LENGTH_REG = 5'd12;
+
+	localparam WORDS = 8;
+	localparam NUM_DIVS = 3;
+
+	// Avalon slave
+	reg clk = 1'b0;
+	reg reset = 1'b1;
+	reg [4:0] address = 5'b0;
+	reg chipselect = 1'b0;
+	reg read = 1'b0;
+	reg write = 1'b0;
+	reg [31:0] writedata = 32'b0;
+	wire [31:0] readdata;
+	wire irq;
+
+	// SPI port
+	wire sclk, tx, cs0, cs1, cs2, cs3;
+	wire mcp_miso, slave_miso;
+	reg use_mcp = 1'b0;
+	reg [7:0] mcp_pins = 8'h00;
+	wire rx = use_mcp ? mcp_miso : slave_miso;
+
+	spi_dev dut(.clk(clk), .reset(reset), .irq(irq),
+					.address(address), .byteenable(4'b1111), .chipselect(chipselect),
+					.read(read), .readdata(readdata), .write(write), .writedata(writedata),
+					.sclk(sclk), .tx(tx), .rx(rx), .cs0(cs0), .cs1(cs1), .cs2(cs2), .cs3(cs3),
+					.dma_address(), .dma_read(), .dma_readdata(32'b0), .dma_write(),
+					.dma_writedata(), .dma_byteenable(), .dma_waitrequest(1'b0));
+
+	mcp23s08_model mcp(.cs_n(cs0 | ~use_mcp), .sclk(sclk), .mosi(tx), .pins(mcp_pins), .miso(mcp_miso));
+
+	// Slave settings, updated by configure
+	reg cpol = 1'b0, cpha = 1'b0, slave_clear = 1'b0;
+	reg [5:0] slave_size = 6'd8;
+
+	spi_mode_slave slave(.cs_n(cs0 | use_mcp), .sclk(sclk), .mosi(tx), .cpol(cpol), .cpha(cpha),
+								.clear(slave_clear), .size(slave_size), .miso(slave_miso));
+
+	always #10 clk = ~clk;
+
+	integer cycle = 0;
+	always @ (posedge clk)
+		cycle <= cycle + 1;
+
+	// Monitor settings, updated by configure
+	reg measuring = 1'b0;
+	integer nominal = 10;
+
+	//==========================================================================================
+	// Avalon master
+
+	task bus_write(input [4:0] addr, input [31:0] data);
+	begin
+		@ (negedge clk);
+		address = addr; writedata = data; write = 1'b1; chipselect = 1'b1;
+		@ (negedge clk);
+		write = 1'b0; chipselect = 1'b0;
+	end
+	endtask
+
+	// readdata is sampled mid-cycle, before the edge-triggered Rx pop takes effect
+	task bus_read(input [4:0] addr, output [31:0] data);
+	begin
+		@ (negedge clk);
+		address = addr; read = 1'b1; chipselect = 1'b1;
+		@ (negedge clk);
+		data = readdata;
+		read = 1'b0; chipselect = 1'b0;
+	end
+	endtask
+
+	task wait_rx(input integer count, input integer limit);
+		integer deadline;
+	begin
+		deadline = cycle + limit;
+		while (dut.RX_count < count && cycle < deadline)
+			@ (posedge clk);
+	end
+	endtask
+
+	task wait_idle(input integer limit);
+		integer deadline;
+	begin
+		deadline = cycle + limit;
+		while ((dut.SER_BUSY | ~cs0) && cycle < deadline)
+			@ (posedge clk);
+	end
+	endtask
+
+	// Restarting ENABLE reloads the baud generator with the new divisor
+	// size is the word size in bits, with 0 meaning 32, and mode is {CPOL, CPHA}
+	// The slave's received words are cleared
+	task configure(input [4:0] size, input [1:0] mode, input integer div);
+		reg [4:0] word_size;
+		reg [1:0] mode_bits;
+	begin
+		word_size = size - 1'b1;
+		mode_bits = {mode[1], mode[1] ^ mode[0]};
+		bus_write(CONTROL_REG, 32'b0);
+		bus_write(BRD_REG, div << 6);
+		cpol = mode[1];
+		cpha = mode[0];
+		slave_size = (size == 0) ? 6'd32 : size;
+		slave_clear = 1'b1;
+		#1 slave_clear = 1'b0;
+		bus_write(CONTROL_REG, word_size | (1 << 5) | (1 << 15) | (mode_bits << 16));
+		nominal = div;
+	end
+	endtask
+
+	//==========================================================================================
+	// SPI port monitor (CS0)
+
+	reg prev_sclk = 1'b0, prev_cs = 1'b1, first_in_frame = 1'b0;
+	integer frames, lead_edges, gaps, gap_cycles, max_gap, setup_min, hold_min;
+	integer cs_fall, last_lead, last_trail, interval;
+	wire sclk_edge = sclk != prev_sclk;
+
+	task monitor_start;
+	begin
+		frames = 0; lead_edges = 0; gaps = 0; gap_cycles = 0; max_gap = 0;
+		setup_min = 32'h7FFFFFFF; hold_min = 32'h7FFFFFFF;
+		last_lead = -1; last_trail = -1;
+		measuring = 1'b1;
+	end
+	endtask
+
+	always @ (posedge clk)
+	begin
+		if (measuring)
+		begin
+			if (prev_cs & ~cs0)
+			begin
+				frames = frames + 1;
+				cs_fall = cycle;
+				first_in_frame = 1'b1;
+			end
+			if (~cs0 & sclk_edge & (sclk != cpol))
+			begin
+				if (first_in_frame && cycle - cs_fall < setup_min)
+					setup_min = cycle - cs_fall;
+				first_in_frame = 1'b0;
+				if (last_lead >= 0)
+				begin
+					interval = cycle - last_lead;
+					if (interval * 2 > nominal * 3)
+					begin
+						gaps = gaps + 1;
+						gap_cycles = gap_cycles + interval - nominal;
+						if (interval - nominal > max_gap)
+							max_gap = interval - nominal;
+					end
+				end
+				last_lead = cycle;
+				lead_edges = lead_edges + 1;
+			end
+			if (~cs0 & sclk_edge & (sclk == cpol))
+				last_trail = cycle;
+			if (~prev_cs & cs0 && last_trail >= 0 && cycle - last_trail < hold_min)
+				hold_min = cycle - last_trail;
+		end
+		prev_sclk <= sclk;
+		prev_cs <= cs0;
+	end
+
+	//==========================================================================================
+	// Checks
+
+	integer errors = 0;
+
+	task check(input ok, input [8*40-1:0] name);
+	begin
+		if (ok)
+			$display("CHECK %0s PASS", name);
+		else
+		begin
+			$display("CHECK %0s FAIL", name);
+			errors = errors + 1;
+		end
+	end
+	endtask
+
+	// One 24-bit MCP23S08 transaction, returning the data byte
+	task mcp_transfer(input [23:0] command, output [7:0] data);
+		reg [31:0] word;
+	begin
+		bus_write(DATA_REG, command);
+		wait_rx(1, 2000);
+		bus_read(DATA_REG, word);
+		data = word[7:0];
+		wait_idle(200);
+	end
+	endtask
+
+	//==========================================================================================
+	// Test sequence
+
+	integer report, divs [0:NUM_DIVS-1];
+	integer m, d, s, w, start, window, mosi_errors, miso_errors;
+	reg frames_ok, gaps_ok, frame_data_ok;
+	reg [4:0] size;
+	reg [31:0] mask, word, sent [0:WORDS-1];
+	reg [7:0] byte_in;
+	reg [8*256-1:0] report_name;
+	real util, avg_gap;
+	reg quick;
+
+	initial
+	begin
+		divs[0] = 4; divs[1] = 10; divs[2] = 50;   // 12.5, 5 and 1 MHz
+		quick = $test$plusargs("quick");
+		if (!$value$plusargs("report=%s", report_name))
+			report_name = "spi_dev_report.csv";
+		report = $fopen(report_name, "w");
+		$fdisplay(report, "word_size,mode,brd_div,words,window_cycles,sclk_util,avg_gap_cycles,max_gap_cycles,cs_frames,cs_setup_min,cs_hold_min,sclk_edges,extra_edges,tx_ov,rx_ov,mosi_errors,miso_errors");
+
+		repeat (4) @ (posedge clk);
+		reset = 1'b0;
+		repeat (4) @ (posedge clk);
+
+		//--------------------------------------------------------------------------------------
+		// WORD_SIZE x MODE x BRD sweep over the CPOL/CPHA slave
+		for (m = 0; m < 4; m = m + 1)
+		for (d = 0; d < NUM_DIVS; d = d + 1)
+		for (s = 1; s <= 32; s = s + 1)
+		begin
+			if (!quick || s == 1 || s == 8 || s == 16 || s == 24 || s == 32)
+			begin
+				size = s;
+				mask = (s == 32) ? 32'hFFFFFFFF : ((32'h1 << s) - 1);
+				configure(size, m, divs[d]);
+				monitor_start;
+				start = cycle;
+				for (w = 0; w < WORDS; w = w + 1)
+				begin
+					sent[w] = $random;
+					bus_write(DATA_REG, sent[w]);
+				end
+				wait_rx(WORDS, WORDS * (s + 4) * divs[d] * 2 + 1000);
+				window = cycle - start;
+				wait_idle(4 * divs[d] + 100);
+				measuring = 1'b0;
+
+				mosi_errors = (slave.rx_count == WORDS) ? 0 : WORDS;
+				miso_errors = 0;
+				for (w = 0; w < WORDS; w = w + 1)
+				begin
+					if (slave.rx_words[w] !== (sent[w] & mask))
+						mosi_errors = mosi_errors + 1;
+					bus_read(DATA_REG, word);
+					if (word !== (slave.tx_words[w] & mask))
+						miso_errors = miso_errors + 1;
+				end
+				bus_read(STATUS_REG, word);
+
+				util = (WORDS * s * divs[d] * 1.0) / window;
+				avg_gap = (WORDS > 1) ? gap_cycles * 1.0 / (WORDS - 1) : 0.0;
+				$fdisplay(report, "%0d,%0d,%0d,%0d,%0d,%0.4f,%0.2f,%0d,%0d,%0d,%0d,%0d,%0d,%0d,%0d,%0d,%0d",
+							 s, m, divs[d], WORDS, window, util, avg_gap, max_gap, frames,
+							 setup_min, hold_min, lead_edges, lead_edges - WORDS * s,
+							 word[3], word[0], mosi_errors, miso_errors);
+				if (mosi_errors != 0 || miso_errors != 0 || lead_edges != WORDS * s || word[3] || word[0])
+				begin
+					$display("sweep size %0d mode %0d div %0d: %0d MOSI and %0d MISO errors, %0d edges, status 0x%08x",
+								s, m, divs[d], mosi_errors, miso_errors, lead_edges, word);
+					errors = errors + 1;
+				end
+			end
+		end
+		$display("CHECK sweep %0s", (errors == 0) ? "PASS" : "FAIL");
+
+		//--------------------------------------------------------------------------------------
+		// FRAME_LENGTH keeps CS asserted with no gap between words, in every mode
+		frames_ok = 1'b1; gaps_ok = 1'b1; frame_data_ok = 1'b1;
+		for (m = 0; m < 4; m = m + 1)
+		begin
+			configure(8, m, 10);
+			bus_write(FRAME_LENGTH_REG, WORDS);
+			monitor_start;
+			for (w = 0; w < WORDS; w = w + 1)
+				bus_write(DATA_REG, w + 8'hA0);
+			wait_rx(WORDS, 4000);
+			wait_idle(200);
+			measuring = 1'b0;
+			if (frames != 1) frames_ok = 1'b0;
+			if (gaps != 0) gaps_ok = 1'b0;
+			if (slave.rx_count != WORDS) frame_data_ok = 1'b0;
+			for (w = 0; w < WORDS; w = w + 1)
+			begin
+				bus_read(DATA_REG, word);
+				if (slave.rx_words[w] !== w + 8'hA0 || word !== (slave.tx_words[w] & 32'hFF))
+					frame_data_ok = 1'b0;
+			end
+		end
+		check(frames_ok, "frame_single_cs");
+		check(gaps_ok, "frame_no_gaps");
+		check(frame_data_ok, "frame_data");
+		bus_write(FRAME_LENGTH_REG, 0);
+		bus_write(STATUS_REG, 32'h000000C0);   // reset both FIFOs
+
+		//--------------------------------------------------------------------------------------
+		// Tx overflow: more words than the FIFO holds at a slow baud rate
+		configure(32, 0, 200);
+		for (w = 0; w < 20; w = w + 1)
+			bus_write(DATA_REG, w);
+		bus_read(STATUS_REG, word);
+		check(word[3] && word[4], "tx_overflow_flag");
+		bus_write(STATUS_REG, 32'h00000008);
+		bus_read(STATUS_REG, word);
+		check(!word[3], "tx_overflow_clear");
+		bus_write(STATUS_REG, 32'h00000080);
+		wait_idle(200 * 40);
+		bus_write(STATUS_REG, 32'h00000040);
+
+		// Rx overflow: one word more than the Rx FIFO holds
+		configure(8, 0, 4);
+		for (w = 0; w < 17; w = w + 1)
+		begin
+			bus_write(DATA_REG, w);
+			wait_idle(200);
+		end
+		bus_read(STATUS_REG, word);
+		check(word[0] && word[1], "rx_overflow_flag");
+		bus_read(FIFO_LEVEL_REG, word);
+		check(word[27:16] == 16, "rx_overflow_count");
+		bus_write(STATUS_REG, 32'h00000041);
+		bus_read(STATUS_REG, word);
+		check(!word[0] && word[2], "rx_overflow_clear");
+
+		// Rx underflow: reading an empty FIFO must not move it
+		bus_read(DATA_REG, word);
+		bus_read(FIFO_LEVEL_REG, word);
+		check(word[27:16] == 0, "rx_underflow_count");
+		bus_read(STATUS_REG, word);
+		check(word[2] && !word[0], "rx_underflow_flags");
+
+		//--------------------------------------------------------------------------------------
+		// MCP23S08 on CS0, mode 0,0 at 5 MHz
+		use_mcp = 1'b1;
+		mcp_pins = 8'hC3;
+		configure(24, 0, 10);
+		mcp_transfer(24'h4000F0, byte_in);     // IODIR = F0
+		mcp_transfer(24'h400A5A, byte_in);     // OLAT = 5A
+		mcp_transfer(24'h4100FF, byte_in);
+		check(byte_in == 8'hF0, "mcp_iodir_readback");
+		mcp_transfer(24'h410AFF, byte_in);
+		check(byte_in == 8'h5A, "mcp_olat_readback");
+		mcp_transfer(24'h4109FF, byte_in);
+		check(byte_in == 8'hCA, "mcp_gpio_read");
+
+		// Sequential write of IODIR..GPINTEN as one CS-held frame of 8-bit words
+		configure(8, 0, 10);
+		bus_write(FRAME_LENGTH_REG, 5);
+		monitor_start;
+		bus_write(DATA_REG, 32'h40);
+		bus_write(DATA_REG, 32'h00);
+		bus_write(DATA_REG, 32'h11);
+		bus_write(DATA_REG, 32'h22);
+		bus_write(DATA_REG, 32'h33);
+		wait_rx(5, 2000);
+		wait_idle(200);
+		measuring = 1'b0;
+		check(frames == 1, "mcp_burst_single_cs");
+		bus_write(FRAME_LENGTH_REG, 0);
+		bus_write(STATUS_REG, 32'h00000040);
+		configure(24, 0, 10);
+		mcp_transfer(24'h4101FF, byte_in);
+		check(byte_in == 8'h22, "mcp_burst_ipol");
+		mcp_transfer(24'h4102FF, byte_in);
+		check(byte_in == 8'h33, "mcp_burst_gpinten");
+		use_mcp = 1'b0;
+
+		$fclose(report);
+		$display("REPORT %0s", report_name);
+		if (errors == 0)
+		begin
+			$display("RESULT PASS");
+			$finish;
+		end
+		else
+		begin
+			$display("RESULT FAIL (%0d)", errors);
+			$fatal(1);
+		end
+	end
+
+endmodule
@@ -17,10 +17,14 @@
 
 //==============================================================================================
 
-module spi_dev (
+module spi_dev #(
+		parameter FIFO_ADDR_WIDTH = 4, // FIFO depth is 2^FIFO_ADDR_WIDTH words (16-1024)
+		parameter DMA_ENABLE = 0       // 1 adds the Avalon-MM DMA master
+	) (
 		input  wire        clk,        //    clk.clk
 		input  wire        reset,      //  reset.reset
-		input  wire [1:0]  address,    // avalon.address
+		output wire        irq,        //    irq.irq
+		input  wire [4:0]  address,    // avalon.address
 		input  wire [3:0]  byteenable, //       .byteenable
 		input  wire        chipselect, //       .chipselect
 		input  wire        read,       //       .read
@@ -33,15 +37,28 @@ module spi_dev (
 		output wire        cs0,        //       .cs0
 		output wire        cs1,        //       .cs1
 		output wire        cs2,        //       .cs2
-		output wire        cs3         //       .cs3
+		output wire        cs3,        //       .cs3
+		output wire [31:0] dma_address,     //    dma.address
+		output wire        dma_read,        //       .read
+		input  wire [31:0] dma_readdata,    //       .readdata
+		output wire        dma_write,       //       .write
+		output wire [31:0] dma_writedata,   //       .writedata
+		output wire [3:0]  dma_byteenable,  //       .byteenable
+		input  wire        dma_waitrequest  //       .waitrequest
 	);
 
 	 // internal    
     wire [31:0] status;
     reg [31:0] control;
     reg [31:0] brd;
+    reg [31:0] int_enable;
+    wire [31:0] int_status;
+    reg [31:0] watermark;
+    wire [31:0] fifo_level;
+    wire [FIFO_ADDR_WIDTH:0] TX_count, RX_count;
 	 wire [31:0] RX_data_out;
 	 wire [31:0] RX_data_in;
+	 wire [32:0] TX_head;
 	 wire [31:0] TX_data; 
 	 
 	 wire TX_FIFO_WRITE;
@@ -55,19 +72,64 @@ module spi_dev (
 	 wire SEL_CS_AUTO, SEL_CS_ENABLE, SEL_CS;
 	 wire [1:0] SEL_MODE;
 	 wire [3:0] CS;
+	 wire TX_LOW, RX_HIGH;
+	 wire SHIFT_ENABLE, FRAME_END;
+	 reg EOF;
+	 reg [31:0] frame_length;
+	 reg [31:0] profile [3:0];
+	 wire PROFILE_ENABLE;
+	 wire [31:0] SEL_PROFILE, SEL_BRD;
+	 wire [4:0] SEL_WORD_SIZE;
+	 wire [7:0] EFF_MODE;
+	 wire [3:0] EFF_CS_AUTO;
+	 wire TX_TAGGED, SER_BUSY;
+	 wire [1:0] NEXT_CS, CUR_CS;
+	 wire [4:0] NEXT_WORD_SIZE;
+	 reg [1:0] active_cs;
+	 reg [32:0] TX_write_data;
+	 reg [31:0] dma_src, dma_dst, dma_count;
+	 reg [2:0] dma_control;
+	 reg DMA_DONE;
+	 wire DMA_START, DMA_BUSY, DMA_FINISHED, DMA_TX_PUSH, DMA_RX_POP;
+	 wire [31:0] DMA_TX_data, DMA_remaining;
 	
 	 // Register Map
     // ofs  fn
-    //   0  data 	  (r/w)
-    //   4  status  (r/w1c)
-    //   8  control (r/w)
-    //  12  brd     (r/w)
+    //   0  data 	     (r/w)
+    //   4  status     (r/w1c)
+    //   8  control    (r/w)
+    //  12  brd        (r/w)
+    //  16  int_enable (r/w)
+    //  20  int_status (r/w1c)
+    //  24  watermark  (r/w)
+    //  28  fifo_level (r)
+    //  32  dma_src    (r/w)
+    //  36  dma_dst    (r/w)
+    //  40  dma_count  (r/w)
+    //  44  dma_control (r/w, done is w1c)
+    //  48  frame_length (r/w)
+    //  52  tagged_data (w)
+    //  64  profile0-3 (r/w, 64 + 4 * cs)
     
     // Register Numbers
-    parameter DATA_REG     = 2'b00;
-    parameter STATUS_REG   = 2'b01;
-    parameter CONTROL_REG  = 2'b10;
-    parameter BRD_REG      = 2'b11;
+    parameter DATA_REG        = 5'b00000;
+    parameter STATUS_REG      = 5'b00001;
+    parameter CONTROL_REG     = 5'b00010;
+    parameter BRD_REG         = 5'b00011;
+    parameter INT_ENABLE_REG  = 5'b00100;
+    parameter INT_STATUS_REG  = 5'b00101;
+    parameter WATERMARK_REG   = 5'b00110;
+    parameter FIFO_LEVEL_REG  = 5'b00111;
+    parameter DMA_SRC_REG     = 5'b01000;
+    parameter DMA_DST_REG     = 5'b01001;
+    parameter DMA_COUNT_REG   = 5'b01010;
+    parameter DMA_CONTROL_REG = 5'b01011;
+    parameter FRAME_LENGTH_REG = 5'b01100;
+    parameter TAGGED_DATA_REG = 5'b01101;
+    parameter PROFILE0_REG    = 5'b10000;
+    parameter PROFILE1_REG    = 5'b10001;
+    parameter PROFILE2_REG    = 5'b10010;
+    parameter PROFILE3_REG    = 5'b10011;
 
 	 // Read Register
     always @ (*)
@@ -82,6 +144,34 @@ module spi_dev (
                     readdata = control;
                 BRD_REG: 
                     readdata = brd;
+                INT_ENABLE_REG: 
+                    readdata = int_enable;
+                INT_STATUS_REG: 
+                    readdata = int_status;
+                WATERMARK_REG: 
+                    readdata = watermark;
+                FIFO_LEVEL_REG: 
+                    readdata = fifo_level;
+                DMA_SRC_REG: 
+                    readdata = dma_src;
+                DMA_DST_REG: 
+                    readdata = dma_dst;
+                DMA_COUNT_REG: 
+                    readdata = DMA_BUSY ? DMA_remaining : dma_count;
+                FRAME_LENGTH_REG: 
+                    readdata = frame_length;
+                PROFILE0_REG: 
+                    readdata = profile[0];
+                PROFILE1_REG: 
+                    readdata = profile[1];
+                PROFILE2_REG: 
+                    readdata = profile[2];
+                PROFILE3_REG: 
+                    readdata = profile[3];
+                DMA_CONTROL_REG: 
+                    readdata = {DMA_ENABLE != 0, 14'b0, DMA_DONE, 6'b0, control[4:0], control[14:13], dma_control[2:1], DMA_BUSY};
+                default:
+                    readdata = 32'b0;
             endcase
         else
             readdata = 32'b0;
@@ -101,8 +191,20 @@ module spi_dev (
 				control[19:18] <= 2'b00;		  // MODE1
 				control[21:20] <= 2'b00;		  // MODE2
 				control[23:22] <= 2'b00;		  // MODE3
-				control[31:24] <= 2'b00;		  // MODE4				
+				control[24]    <= 1'b0;			  // PROFILE_ENABLE
+				control[31:25] <= 7'b0;
 				brd[31:0]		<= 32'h00000280; // 5MHz
+				int_enable     <= 32'b0;
+				watermark      <= 32'b0;
+				dma_src        <= 32'b0;
+				dma_dst        <= 32'b0;
+				dma_count      <= 32'b0;
+				dma_control    <= 3'b0;
+				frame_length   <= 32'b0;
+				profile[0]     <= 32'h0002809F;  // 5MHz, CS auto, mode 0, 32 bits
+				profile[1]     <= 32'h0002809F;
+				profile[2]     <= 32'h0002809F;
+				profile[3]     <= 32'h0002809F;
         end
         else
         begin
@@ -113,6 +215,36 @@ module spi_dev (
                         control <= writedata;
                     BRD_REG: 
                         brd <= writedata;
+                    INT_ENABLE_REG: 
+                        int_enable <= writedata;
+                    WATERMARK_REG: 
+                        watermark <= writedata;
+                    DMA_SRC_REG: 
+                        dma_src <= writedata;
+                    DMA_DST_REG: 
+                        dma_dst <= writedata;
+                    DMA_COUNT_REG: 
+                        dma_count <= writedata;
+                    FRAME_LENGTH_REG: 
+                        frame_length <= writedata;
+                    PROFILE0_REG: 
+                        profile[0] <= writedata;
+                    PROFILE1_REG: 
+                        profile[1] <= writedata;
+                    PROFILE2_REG: 
+                        profile[2] <= writedata;
+                    PROFILE3_REG: 
+                        profile[3] <= writedata;
+                    DMA_CONTROL_REG: 
+                    begin
+                        dma_control <= writedata[2:0];
+                        // Starting a descriptor applies its CS and word size
+                        if (writedata[0] & ~DMA_BUSY)
+                        begin
+                            control[14:13] <= writedata[4:3];
+                            control[4:0] <= writedata[9:5];
+                        end
+                    end
                 endcase
             end
         end
@@ -123,36 +255,172 @@ module spi_dev (
 	assign cs2 = ~CS[2];
 	assign cs3 = ~CS[3];
 	
-	assign RX_FIFO_READ = read & chipselect & (address == DATA_REG);
-	assign TX_FIFO_WRITE = write & chipselect & (address == DATA_REG);
+	assign RX_FIFO_READ = (read & chipselect & (address == DATA_REG)) | DMA_RX_POP;
+	assign TX_FIFO_WRITE = (write & chipselect & ((address == DATA_REG) | (address == TAGGED_DATA_REG))) | DMA_TX_PUSH;
 	assign TX_CLEAR_OV = write & chipselect & (address == STATUS_REG) & writedata[3];
 	assign RX_CLEAR_OV = write & chipselect & (address == STATUS_REG) & writedata[0];
 	assign TX_RESET = write & chipselect & (address == STATUS_REG) & writedata[7];
 	assign RX_RESET = write & chipselect & (address == STATUS_REG) & writedata[6];
 	
+	// Interrupts
+	// bit 0: TX_LOW  - Tx count at or below watermark[15:0] (level)
+	// bit 1: RX_HIGH - Rx count at or above watermark[31:16] (level)
+	// bit 2: EOF     - frame ended with Tx FIFO empty (latched, w1c)
+	// bit 3: DMA     - DMA descriptor completed (latched, w1c)
+	assign TX_LOW = TX_count <= watermark[15:0];
+	assign RX_HIGH = RX_count >= watermark[31:16];
+	assign int_status = {28'b0, DMA_DONE, EOF, RX_HIGH, TX_LOW};
+	assign irq = (int_status & int_enable) != 32'b0;
+	
+	always @ (posedge clk or posedge reset)
+	begin
+		if (reset)
+			EOF <= 1'b0;
+		else
+		begin
+			if (write & chipselect & (address == INT_STATUS_REG) & writedata[2])
+				EOF <= 1'b0;
+			else if (FRAME_END & status[5])
+				EOF <= 1'b1;
+		end
+	end
+	
+	// DMA
+	// A descriptor is started by writing dma_control with bit 0 (GO) set:
+	//   [1] TX: read Tx words from dma_src (otherwise zeros are sent)
+	//   [2] RX: write Rx words to dma_dst (otherwise they are discarded)
+	//   [4:3] CS_SELECT and [9:5] WORD_SIZE copied into control at start
+	// dma_control reads back BUSY in bit 0, DONE in bit 16 and PRESENT in bit 31
+	// The DATA register must not be accessed while BUSY
+	assign DMA_START = write & chipselect & (address == DMA_CONTROL_REG) & writedata[0];
+	
+	always @ (posedge clk or posedge reset)
+	begin
+		if (reset)
+			DMA_DONE <= 1'b0;
+		else
+		begin
+			if (DMA_FINISHED)
+				DMA_DONE <= 1'b1;
+			else if (write & chipselect & (address == DMA_CONTROL_REG) & writedata[16])
+				DMA_DONE <= 1'b0;
+			else if (write & chipselect & (address == INT_STATUS_REG) & writedata[3])
+				DMA_DONE <= 1'b0;
+		end
+	end
+	
+	generate
+		if (DMA_ENABLE)
+		begin : dma
+			dma_master #(.COUNT_WIDTH(FIFO_ADDR_WIDTH+1)) dma_master(.CLK(clk), .RESET(reset),
+												 .START(DMA_START & ~DMA_BUSY),
+												 .SRC(dma_src), .DST(dma_dst), .COUNT(dma_count),
+												 .TX_ENABLE(writedata[1]), .RX_ENABLE(writedata[2]),
+												 .BUSY(DMA_BUSY), .FINISHED(DMA_FINISHED), .REMAINING(DMA_remaining),
+												 .DEPTH(1 << FIFO_ADDR_WIDTH), .TX_COUNT(TX_count), .RX_COUNT(RX_count),
+												 .TX_PUSH(DMA_TX_PUSH), .TX_DATA(DMA_TX_data),
+												 .RX_POP(DMA_RX_POP), .RX_DATA(RX_data_out),
+												 .ADDRESS(dma_address), .READ(dma_read), .READDATA(dma_readdata),
+												 .WRITE(dma_write), .WRITEDATA(dma_writedata),
+												 .WAITREQUEST(dma_waitrequest)
+												 );
+		end
+		else
+		begin : no_dma
+			assign DMA_BUSY = 1'b0;
+			assign DMA_FINISHED = 1'b0;
+			assign DMA_remaining = 32'b0;
+			assign DMA_TX_PUSH = 1'b0;
+			assign DMA_TX_data = 32'b0;
+			assign DMA_RX_POP = 1'b0;
+			assign dma_address = 32'b0;
+			assign dma_read = 1'b0;
+			assign dma_write = 1'b0;
+			assign dma_writedata = 32'b0;
+		end
+	endgenerate
+	assign dma_byteenable = 4'b1111;
+	
+	// Per-CS profiles
+	// MODEn[1] is CPOL (SCLK_OUT idle level) and MODEn[0] is CPOL ^ CPHA, as
+	// the serializer samples RX on the rising edge of BAUD ^ MODEn[1] ^ MODEn[0]
+	// profileN[4:0] is WORD_SIZE, [6:5] is MODE (same encoding as CONTROL),
+	// [7] is CS_AUTO and [31:8] is the baud rate divisor (brd[23:0])
+	// When control[24] is set the profile of CS_SELECT replaces the global
+	// WORD_SIZE, MODEn, CS_AUTOn and BRD, so changing device is one write
+	assign PROFILE_ENABLE = control[24];
+	assign SEL_PROFILE = profile[CUR_CS];
+	assign SEL_WORD_SIZE = PROFILE_ENABLE ? SEL_PROFILE[4:0] : control[4:0];
+	assign SEL_BRD = PROFILE_ENABLE ? {8'b0, SEL_PROFILE[31:8]} : brd;
+	assign EFF_MODE = PROFILE_ENABLE ? {profile[3][6:5], profile[2][6:5], profile[1][6:5], profile[0][6:5]} : control[23:16];
+	assign EFF_CS_AUTO = PROFILE_ENABLE ? {profile[3][7], profile[2][7], profile[1][7], profile[0][7]} : control[8:5];
+	
+	// Tagged Tx words
+	// Words written to tagged_data carry their own target: [31:30] is the CS,
+	// [29:25] is WORD_SIZE and [24:0] is the data (up to 25 bits). The tag is
+	// kept in bit 32 of the Tx FIFO, and the CS of the word at the head of the
+	// FIFO is used while idle and held in active_cs until its frame ends, so
+	// traffic for several devices can be queued without draining the FIFO
+	assign TX_TAGGED = TX_head[32] & ~status[5];
+	assign TX_data = TX_TAGGED ? {7'b0, TX_head[24:0]} : TX_head[31:0];
+	assign NEXT_CS = TX_TAGGED ? TX_head[31:30] : control[14:13];
+	assign CUR_CS = SER_BUSY ? active_cs : NEXT_CS;
+	assign NEXT_WORD_SIZE = TX_TAGGED ? TX_head[29:25] : SEL_WORD_SIZE;
+	
+	always @ (posedge clk or posedge reset)
+	begin
+		if (reset)
+			active_cs <= 2'b00;
+		else if (~SER_BUSY)
+			active_cs <= NEXT_CS;
+	end
+	
+	// The Tx FIFO pushes one clock after the write strobe (edge_detect), when
+	// address and writedata may already belong to the next bus cycle, so the
+	// tag bit and data are registered on the strobe and pushed from here
+	always @ (posedge clk or posedge reset)
+	begin
+		if (reset)
+			TX_write_data <= 33'b0;
+		else if (write & chipselect & ((address == DATA_REG) | (address == TAGGED_DATA_REG)))
+			TX_write_data <= {address == TAGGED_DATA_REG, writedata};
+	end
+	
 	clock_generator clock_generator (.clk(clk), .reset(reset), 
-												.enable(control[15]), .brd(brd), .baud_out(BAUD_CLOCK));
+												.enable(control[15]), .brd(SEL_BRD), .baud_out(BAUD_CLOCK));
 	
-	edge_triggered_FIFO TX_FIFO(.Read(TX_FIFO_READ),
+	// FIFO levels
+	// fifo_level[11:0] is the Tx count and [15:12] is log2 of the Tx depth
+	// fifo_level[27:16] is the Rx count and [31:28] is log2 of the Rx depth
+	// status[15:12] and status[11:8] hold the same counts saturated at 15
+	assign fifo_level[11:0] = TX_count;
+	assign fifo_level[15:12] = FIFO_ADDR_WIDTH;
+	assign fifo_level[27:16] = RX_count;
+	assign fifo_level[31:28] = FIFO_ADDR_WIDTH;
+	assign status[15:12] = (TX_count > 15) ? 4'hF : TX_count[3:0];
+	assign status[11:8] = (RX_count > 15) ? 4'hF : RX_count[3:0];
+	
+	edge_triggered_FIFO #(.ADDR_WIDTH(FIFO_ADDR_WIDTH), .DATA_WIDTH(33)) TX_FIFO(.Read(TX_FIFO_READ),
 									    .Write(TX_FIFO_WRITE),
 									    .ClearOV(TX_CLEAR_OV),
 									    .Clock(clk), .Reset(reset|TX_RESET),
-								       .DataIn(writedata), .DataOut(TX_data), .store_count(status[15:12]),
+								       .DataIn(DMA_BUSY ? {1'b0, DMA_TX_data} : TX_write_data),
+								       .DataOut(TX_head), .store_count(TX_count),
 								       .Full(status[4]), .Empty(status[5]), .OV(status[3]));
 									 
-	edge_triggered_FIFO RX_FIFO(.Read(RX_FIFO_READ),
+	edge_triggered_FIFO #(.ADDR_WIDTH(FIFO_ADDR_WIDTH)) RX_FIFO(.Read(RX_FIFO_READ),
 									    .Write(RX_FIFO_WRITE),
 									    .ClearOV(RX_CLEAR_OV),
 									    .Clock(clk), .Reset(reset|RX_RESET),
-								       .DataIn(RX_data_in), .DataOut(RX_data_out), .store_count(status[11:8]),
+								       .DataIn(RX_data_in), .DataOut(RX_data_out), .store_count(RX_count),
 								       .Full(status[1]), .Empty(status[2]), .OV(status[0]));
 	
 	cs_sclk_manager manager(.SCLK_IN(BAUD_CLOCK),
-									.SCLK_ENABLE(TX_FIFO_READ),
+									.SCLK_ENABLE(SHIFT_ENABLE),
 									.CS_ASSERT(CS_ASSERT),
-									.MODE(control[23:16]),
-									.CS_SELECT(control[14:13]),
-									.CS_AUTO(control[8:5]),
+									.MODE(EFF_MODE),
+									.CS_SELECT(CUR_CS),
+									.CS_AUTO(EFF_CS_AUTO),
 									.CS_ENABLE(control[12:9]),
 									.SEL_CS_AUTO(SEL_CS_AUTO),
 									.SEL_CS_ENABLE(SEL_CS_ENABLE),
@@ -167,15 +435,20 @@ module spi_dev (
 										 .SCLK((~BAUD_CLOCK & (SEL_MODE[1] ^ SEL_MODE[0])) | (BAUD_CLOCK & ~(SEL_MODE[1] ^ SEL_MODE[0]))),
 									    .RESET(reset),
 									    .SEND(~status[5]),
+									    .NEXT_TAGGED(TX_TAGGED),
 									    .CS_AUTO(SEL_CS_AUTO),
 									    .CS_ENABLE(SEL_CS_ENABLE),
 									    .MODE(SEL_MODE),
-									    .WORD_SIZE(control[4:0]),
+									    .WORD_SIZE(NEXT_WORD_SIZE),
+									    .FRAME_LENGTH(TX_TAGGED ? 16'd1 : frame_length[15:0]),
 										 .RX(rx),
 										 .RX_FIFO_WRITE(RX_FIFO_WRITE),
 										 .DATA_OUT(RX_data_in),
 										 .TX(tx),
 									    .TX_FIFO_READ(TX_FIFO_READ),
+									    .SHIFT_ENABLE(SHIFT_ENABLE),
+									    .FRAME_END(FRAME_END),
+									    .BUSY(SER_BUSY),
 										 .DATA_IN(TX_data),
 									    .CS_ASSERT(CS_ASSERT)
 									    );
@@ -249,11 +522,11 @@ endmodule
 
 //==============================================================================================
 
-module edge_triggered_FIFO(
+module edge_triggered_FIFO #(parameter ADDR_WIDTH = 4, parameter DATA_WIDTH = 32)(
 	input  Read, Write, Clock, Reset, ClearOV,
-	input  [31:0] DataIn,
-	output [31:0] DataOut,
-	output [3:0] store_count,			
+	input  [DATA_WIDTH-1:0] DataIn,
+	output [DATA_WIDTH-1:0] DataOut,
+	output [ADDR_WIDTH:0] store_count,			
 	output Full, Empty, OV);
 	
 	wire read_edge, write_edge, clearOV_edge;
@@ -267,7 +540,7 @@ module edge_triggered_FIFO(
 	edge_detect clearOV_edge_detect(.signal_in(ClearOV), .clock(Clock),
 											  .signal_out(clearOV_edge));
 	
-	FIFO FIFO(.Read(read_edge), .Write(write_edge), 
+	FIFO #(.ADDR_WIDTH(ADDR_WIDTH), .DATA_WIDTH(DATA_WIDTH)) FIFO(.Read(read_edge), .Write(write_edge), 
 				 .Clock(Clock), .Reset(Reset), .ClearOV(clearOV_edge),
 				 .DataIn(DataIn), .DataOut(DataOut), .store_count(store_count),
 				 .Full(Full), .Empty(Empty), .OV(OV));
@@ -277,61 +550,202 @@ endmodule
 
 //==============================================================================================
 
-module FIFO(
+// Show-ahead FIFO of 2^ADDR_WIDTH words
+// Storage is a simple dual-port RAM with a registered read address so deep
+// FIFOs (ADDR_WIDTH >= 6) are inferred as M10K blocks instead of registers
+module FIFO #(parameter ADDR_WIDTH = 4, parameter DATA_WIDTH = 32)(
 	input  Read, Write, Clock, Reset, ClearOV,
-	input  [31:0] DataIn,
-	output wire [31:0] DataOut,
-	output reg [3:0] store_count,
+	input  [DATA_WIDTH-1:0] DataIn,
+	output wire [DATA_WIDTH-1:0] DataOut,
+	output reg [ADDR_WIDTH:0] store_count,
 	output wire Full, Empty, OV
 	);
 	
-	reg [31:0] Stack [15:0]; //Storage array
-	reg [1:0] state;
-	reg [3:0] ReadPtr, WritePtr;
-	parameter EMPTY = 2'b00, NEUTRAL = 2'b01, FULL = 2'b10, OVR = 2'b11;
+	localparam DEPTH = 1 << ADDR_WIDTH;
 	
-	assign Empty = state==EMPTY;
-	assign Full = (state==FULL)|(state==OVR);
-	assign OV = state==OVR;
-	assign DataOut = Stack[ReadPtr];
+	(* ramstyle = "no_rw_check" *) reg [DATA_WIDTH-1:0] Stack [0:DEPTH-1]; //Storage array
+	reg [ADDR_WIDTH-1:0] ReadPtr, WritePtr;
+	reg [DATA_WIDTH-1:0] ram_out, bypass_data;
+	reg use_bypass, ovr;
+	
+	wire do_read  = Read & ~Empty & ~ovr;
+	wire do_write = Write & (~Full | do_read) & ~ovr;
+	wire [ADDR_WIDTH-1:0] next_read = do_read ? ReadPtr + 1'b1 : ReadPtr;
+	
+	assign Empty = store_count == 0;
+	assign Full = store_count == DEPTH;
+	assign OV = ovr;
+	assign DataOut = use_bypass ? bypass_data : ram_out;
+	
+	// RAM port: the head word for the next cycle is read every cycle; a write
+	// to that same address is forwarded around the RAM
+	always @ (posedge Clock)
+	begin
+		if (do_write)
+			Stack[WritePtr] <= DataIn;
+		ram_out <= Stack[next_read];
+		bypass_data <= DataIn;
+		use_bypass <= do_write & (WritePtr == next_read);
+	end
 	
 	always @ (posedge Clock, posedge Reset)
 	begin 
 		if(Reset)
 		begin
-			state = EMPTY;
-			ReadPtr = 4'd0; WritePtr = 4'd0; store_count = 4'd0;
+			ReadPtr <= 0; WritePtr <= 0; store_count <= 0; ovr <= 1'b0;
 		end
 		else
 		begin
-			case(state)
-				EMPTY:
+			if (do_read)
+				ReadPtr <= ReadPtr + 1'b1;
+			if (do_write)
+				WritePtr <= WritePtr + 1'b1;
+			if (do_write & ~do_read)
+				store_count <= store_count + 1'b1;
+			else if (do_read & ~do_write)
+				store_count <= store_count - 1'b1;
+			// Writing while full sets overflow, which holds the FIFO until cleared
+			if (ClearOV)
+				ovr <= 1'b0;
+			else if (Write & Full & ~do_read)
+				ovr <= 1'b1;
+		end
+	end
+	
+endmodule
+
+//==============================================================================================
+
+// Avalon-MM DMA master
+// Streams COUNT words from SRC into the Tx FIFO and from the Rx FIFO to DST,
+// keeping no more words in flight than the Rx FIFO can hold
+module dma_master #(parameter COUNT_WIDTH = 5)(
+	input CLK, RESET, START,
+	input [31:0] SRC, DST, COUNT,
+	input TX_ENABLE, RX_ENABLE,
+	output reg BUSY, FINISHED,
+	output [31:0] REMAINING,
+	input [COUNT_WIDTH-1:0] DEPTH, TX_COUNT, RX_COUNT,
+	output reg TX_PUSH,
+	output reg [31:0] TX_DATA,
+	output reg RX_POP,
+	input [31:0] RX_DATA,
+	output reg [31:0] ADDRESS,
+	output reg READ, WRITE,
+	output reg [31:0] WRITEDATA,
+	input [31:0] READDATA,
+	input WAITREQUEST
+	);
+	
+	reg [31:0] src_ptr, dst_ptr, tx_left, rx_left;
+	reg [COUNT_WIDTH-1:0] in_flight;
+	reg tx_enable, rx_enable;
+	reg [1:0] settle;
+	reg [2:0] state;
+	parameter IDLE_STATE = 3'b000, DECIDE_STATE = 3'b001, TX_READ_STATE = 3'b010,
+	          RX_WRITE_STATE = 3'b011, SETTLE_STATE = 3'b100;
+	
+	assign REMAINING = rx_left;
+	
+	always @ (posedge CLK or posedge RESET)
+	begin
+		if (RESET)
+		begin
+			state <= IDLE_STATE;
+			BUSY <= 1'b0; FINISHED <= 1'b0;
+			TX_PUSH <= 1'b0; RX_POP <= 1'b0;
+			READ <= 1'b0; WRITE <= 1'b0;
+			tx_left <= 32'b0; rx_left <= 32'b0;
+		end
+		else
+		begin
+			// FIFO strobes are single cycle pulses, the FIFOs are edge triggered
+			TX_PUSH <= 1'b0; RX_POP <= 1'b0; FINISHED <= 1'b0;
+			case (state)
+				IDLE_STATE:
 				begin
-					if(Read)  begin state = EMPTY; end																												  //1
-					if(Write) begin state = NEUTRAL; Stack[WritePtr]=DataIn; WritePtr = WritePtr+1'b1; store_count = store_count+1'b1; end //2
+					if (START)
+					begin
+						src_ptr <= SRC; dst_ptr <= DST;
+						tx_left <= COUNT; rx_left <= COUNT;
+						tx_enable <= TX_ENABLE; rx_enable <= RX_ENABLE;
+						in_flight <= 0;
+						BUSY <= 1'b1;
+						state <= DECIDE_STATE;
+					end
 				end
-				NEUTRAL:
+				DECIDE_STATE:
 				begin
-					if(Read  && (store_count == 1))  begin state = EMPTY; ReadPtr = ReadPtr+1'b1; store_count = store_count-1'b1; end 									 //3
-					if(Write && (store_count < 14))  begin state = NEUTRAL; Stack[WritePtr]=DataIn; WritePtr = WritePtr+1'b1; store_count = store_count+1'b1; end //4
-					if(Read  && (store_count > 1))   begin state = NEUTRAL; ReadPtr  = ReadPtr+1'b1; store_count = store_count-1'b1; end 								 //5
-					if(Write && (store_count == 14)) begin state = FULL; Stack[WritePtr]=DataIn; WritePtr = WritePtr+1'b1; store_count = store_count+1'b1; end    //6
+					if (rx_left == 0)
+					begin
+						BUSY <= 1'b0; FINISHED <= 1'b1;
+						state <= IDLE_STATE;
+					end
+					// Drain received words first so the Rx FIFO never overflows
+					else if (RX_COUNT != 0)
+					begin
+						WRITEDATA <= RX_DATA; RX_POP <= 1'b1;
+						rx_left <= rx_left - 1'b1; in_flight <= in_flight - 1'b1;
+						if (rx_enable)
+						begin
+							ADDRESS <= dst_ptr; WRITE <= 1'b1;
+							state <= RX_WRITE_STATE;
+						end
+						else
+						begin
+							settle <= 2'd2; state <= SETTLE_STATE;
+						end
+					end
+					else if ((tx_left != 0) && (TX_COUNT < DEPTH) && (in_flight < DEPTH))
+					begin
+						if (tx_enable)
+						begin
+							ADDRESS <= src_ptr; READ <= 1'b1;
+							state <= TX_READ_STATE;
+						end
+						else
+						begin
+							TX_DATA <= 32'b0; TX_PUSH <= 1'b1;
+							tx_left <= tx_left - 1'b1; in_flight <= in_flight + 1'b1;
+							settle <= 2'd2; state <= SETTLE_STATE;
+						end
+					end
+				end
+				TX_READ_STATE:
+				begin
+					if (!WAITREQUEST)
+					begin
+						READ <= 1'b0; TX_DATA <= READDATA; TX_PUSH <= 1'b1;
+						src_ptr <= src_ptr + 3'd4;
+						tx_left <= tx_left - 1'b1; in_flight <= in_flight + 1'b1;
+						settle <= 2'd2; state <= SETTLE_STATE;
+					end
 				end
-				FULL: 
+				RX_WRITE_STATE:
 				begin
-					if(Read)  begin state = NEUTRAL; ReadPtr = ReadPtr+1'b1; store_count = store_count-1'b1; end //7
-					if(Write) begin state = OVR; end																				   //8
-					
+					if (!WAITREQUEST)
+					begin
+						WRITE <= 1'b0;
+						dst_ptr <= dst_ptr + 3'd4;
+						settle <= 2'd1; state <= SETTLE_STATE;
+					end
 				end
-				OVR: 
+				SETTLE_STATE:
 				begin
-					if(Read || Write) begin state = OVR; end  // 9
-					if(ClearOV) 		begin state = FULL; end //10
+					// Wait for the edge detected strobe to reach the FIFO counts
+					if (settle == 0)
+						state <= DECIDE_STATE;
+					else
+						settle <= settle - 1'b1;
+				end
+				default:
+				begin
+					state <= IDLE_STATE;
 				end
 			endcase
 		end
 	end
-	
+
 endmodule
 
 //==============================================================================================
@@ -377,33 +791,51 @@ endmodule
 
 //==============================================================================================
 
+// Shifts words out on TX and in on RX
+// FRAME_LENGTH words (0 is treated as 1) are sent back to back under one
+// chip select assertion; if the Tx FIFO runs dry mid-frame the clock stops
+// and CS is held until the next word arrives
+// A tagged word (NEXT_TAGGED) is always sent as its own frame and ends any
+// untagged frame in progress, since it may be for a different device
 module serializer(
-	input CLK, SCLK, RESET, SEND,
+	input CLK, SCLK, RESET, SEND, NEXT_TAGGED,
 	input CS_AUTO, CS_ENABLE,
 	input [1:0] MODE,
 	input [4:0] WORD_SIZE,
+	input [15:0] FRAME_LENGTH,
 	input [31:0] DATA_IN,
 	input RX,
-	output RX_FIFO_WRITE,
+	output reg RX_FIFO_WRITE,
 	output reg [31:0] DATA_OUT,
 	output reg TX_FIFO_READ,
+	output reg SHIFT_ENABLE,
+	output reg FRAME_END,
+	output BUSY,
 	output reg TX,
 	output reg CS_ASSERT
 	);
 
 	reg [4:0] count;
 	reg [31:0] latch_data;
+	reg [31:0] shift_in;
+	reg [15:0] frame_left;
 	reg [1:0] state;
 	reg last_sclk;
-	parameter IDLE_STATE = 2'b00, CS_ASSERT_STATE = 2'b01, TX_RX_STATE = 2'b10;
+	parameter IDLE_STATE = 2'b00, CS_ASSERT_STATE = 2'b01, TX_RX_STATE = 2'b10, HOLD_STATE = 2'b11;
 	
-	assign RX_FIFO_WRITE = ~TX_FIFO_READ;
+	assign BUSY = state != IDLE_STATE;
 	
 	always @ (posedge CLK)
 	begin
+		// FIFO strobes and FRAME_END are single cycle pulses
+		TX_FIFO_READ <= 1'b0;
+		RX_FIFO_WRITE <= 1'b0;
+		FRAME_END <= 1'b0;
 		if(RESET)
 		begin
-		state = IDLE_STATE;
+			state <= IDLE_STATE;
+			SHIFT_ENABLE <= 1'b0;
+			CS_ASSERT <= 1'b0;
 		end
 		else
 		begin
@@ -414,35 +846,76 @@ module serializer(
 					case(state)
 						IDLE_STATE:
 						begin
-							TX_FIFO_READ = 0; count = WORD_SIZE; CS_ASSERT = 0; latch_data = DATA_IN;
-							if(SEND & CS_AUTO) begin state = CS_ASSERT_STATE; end
-							if(SEND & ~CS_AUTO) begin state = TX_RX_STATE; end
+							SHIFT_ENABLE <= 1'b0; CS_ASSERT <= 1'b0;
+							count <= WORD_SIZE; latch_data <= DATA_IN; shift_in <= 32'b0;
+							frame_left <= (FRAME_LENGTH == 0) ? 16'd1 : FRAME_LENGTH;
+							if(SEND)
+							begin
+								TX_FIFO_READ <= 1'b1;
+								state <= CS_AUTO ? CS_ASSERT_STATE : TX_RX_STATE;
+							end
 						end
 						CS_ASSERT_STATE:
 						begin
-							TX_FIFO_READ = 0; count = WORD_SIZE; CS_ASSERT = 1;
-							state = TX_RX_STATE;
+							CS_ASSERT <= 1'b1;
+							state <= TX_RX_STATE;
 						end
 						TX_RX_STATE: 
 						begin
-							DATA_OUT[count] = RX; TX_FIFO_READ = 1; CS_ASSERT = 1;
-							if(count == 0) begin state = IDLE_STATE; end
-							else begin state = TX_RX_STATE; count = count-1'b1; end
+							SHIFT_ENABLE <= 1'b1; CS_ASSERT <= 1'b1;
+							if(count == 0)
+							begin
+								DATA_OUT <= shift_in | RX; RX_FIFO_WRITE <= 1'b1;
+								if(frame_left > 1 & ~(SEND & NEXT_TAGGED))
+								begin
+									frame_left <= frame_left - 1'b1;
+									if(SEND)
+									begin
+										// Next word of the frame follows with no gap
+										count <= WORD_SIZE; latch_data <= DATA_IN; shift_in <= 32'b0;
+										TX_FIFO_READ <= 1'b1;
+									end
+									else
+										state <= HOLD_STATE;
+								end
+								else
+								begin
+									FRAME_END <= 1'b1;
+									state <= IDLE_STATE;
+								end
+							end
+							else
+							begin
+								shift_in[count] <= RX;
+								count <= count - 1'b1;
+							end
 						end
-						default:
+						HOLD_STATE:
 						begin
-							state = IDLE_STATE;
+							// Clock stopped, CS held until the frame continues
+							SHIFT_ENABLE <= 1'b0; CS_ASSERT <= 1'b1;
+							if(SEND & NEXT_TAGGED)
+							begin
+								FRAME_END <= 1'b1;
+								state <= IDLE_STATE;
+							end
+							else if(SEND)
+							begin
+								count <= WORD_SIZE; latch_data <= DATA_IN; shift_in <= 32'b0;
+								TX_FIFO_READ <= 1'b1;
+								state <= TX_RX_STATE;
+							end
 						end
 					endcase
 				end
 				else
 				begin
-					if(state == TX_RX_STATE) begin TX = latch_data[count]; end
-						else begin TX = 0; end
+					if(state == TX_RX_STATE) TX <= latch_data[count];
+					else TX <= 1'b0;
 				end
 			end
 		end
-		last_sclk = SCLK;
+		last_sclk <= SCLK;
 	end
 
 endmodule
@@ -30,6 +30,7 @@ set_module_property EDITABLE true
 set_module_property REPORT_TO_TALKBACK false
 set_module_property ALLOW_GREYBOX_GENERATION false
 set_module_property REPORT_HIERARCHY false
+set_module_property ELABORATION_CALLBACK elaborate
 
 
 # 
@@ -50,6 +51,32 @@ add_fileset_file spi_dev.v VERILOG PATH spi_dev.v
 # 
 # parameters
 # 
+add_parameter FIFO_ADDR_WIDTH INTEGER 4
+set_parameter_property FIFO_ADDR_WIDTH DEFAULT_VALUE 4
+set_parameter_property FIFO_ADDR_WIDTH DISPLAY_NAME FIFO_ADDR_WIDTH
+set_parameter_property FIFO_ADDR_WIDTH DESCRIPTION "FIFO depth is 2^FIFO_ADDR_WIDTH words"
+set_parameter_property FIFO_ADDR_WIDTH TYPE INTEGER
+set_parameter_property FIFO_ADDR_WIDTH UNITS None
+set_parameter_property FIFO_ADDR_WIDTH ALLOWED_RANGES 4:10
+set_parameter_property FIFO_ADDR_WIDTH HDL_PARAMETER true
+add_parameter DMA_ENABLE INTEGER 0
+set_parameter_property DMA_ENABLE DEFAULT_VALUE 0
+set_parameter_property DMA_ENABLE DISPLAY_NAME DMA_ENABLE
+set_parameter_property DMA_ENABLE DESCRIPTION "Adds the Avalon-MM DMA master"
+set_parameter_property DMA_ENABLE TYPE INTEGER
+set_parameter_property DMA_ENABLE UNITS None
+set_parameter_property DMA_ENABLE ALLOWED_RANGES 0:1
+set_parameter_property DMA_ENABLE HDL_PARAMETER true
+
+
+# 
+# elaboration
+# 
+proc elaborate {} {
+    if {[get_parameter_value DMA_ENABLE] == 0} {
+        set_interface_property dma ENABLED false
+    }
+}
 
 
 # 
@@ -98,7 +125,7 @@ set_interface_property avalon PORT_NAME_MAP ""
 set_interface_property avalon CMSIS_SVD_VARIABLES ""
 set_interface_property avalon SVD_ADDRESS_GROUP ""
 
-add_interface_port avalon address address Input 2
+add_interface_port avalon address address Input 5
 add_interface_port avalon byteenable byteenable Input 4
 add_interface_port avalon chipselect chipselect Input 1
 add_interface_port avalon read read Input 1
@@ -111,6 +138,42 @@ set_interface_assignment avalon embeddedsw.configuration.isNonVolatileStorage 0
 set_interface_assignment avalon embeddedsw.configuration.isPrintableDevice 0
 
 
+# 
+# connection point dma
+# 
+add_interface dma avalon start
+set_interface_property dma addressUnits SYMBOLS
+set_interface_property dma associatedClock clk
+set_interface_property dma associatedReset reset
+set_interface_property dma bitsPerSymbol 8
+set_interface_property dma burstOnBurstBoundariesOnly false
+set_interface_property dma burstcountUnits WORDS
+set_interface_property dma doStreamReads false
+set_interface_property dma doStreamWrites false
+set_interface_property dma holdTime 0
+set_interface_property dma linewrapBursts false
+set_interface_property dma maximumPendingReadTransactions 0
+set_interface_property dma maximumPendingWriteTransactions 0
+set_interface_property dma readLatency 0
+set_interface_property dma readWaitTime 1
+set_interface_property dma setupTime 0
+set_interface_property dma timingUnits Cycles
+set_interface_property dma writeWaitTime 0
+set_interface_property dma ENABLED true
+set_interface_property dma EXPORT_OF ""
+set_interface_property dma PORT_NAME_MAP ""
+set_interface_property dma CMSIS_SVD_VARIABLES ""
+set_interface_property dma SVD_ADDRESS_GROUP ""
+
+add_interface_port dma dma_address address Output 32
+add_interface_port dma dma_read read Output 1
+add_interface_port dma dma_readdata readdata Input 32
+add_interface_port dma dma_write write Output 1
+add_interface_port dma dma_writedata writedata Output 32
+add_interface_port dma dma_byteenable byteenable Output 4
+add_interface_port dma dma_waitrequest waitrequest Input 1
+
+
 # 
 # connection point port
 # 
@@ -145,3 +208,21 @@ set_interface_property clk SVD_ADDRESS_GROUP ""
 
 add_interface_port clk clk clk Input 1
 
+
+# 
+# connection point irq
+# 
+add_interface irq interrupt end
+set_interface_property irq associatedAddressablePoint avalon
+set_interface_property irq associatedClock clk
+set_interface_property irq associatedReset reset
+set_interface_property irq bridgedReceiverOffset 0
+set_interface_property irq bridgesToReceiver ""
+set_interface_property irq ENABLED true
+set_interface_property irq EXPORT_OF ""
+set_interface_property irq PORT_NAME_MAP ""
+set_interface_property irq CMSIS_SVD_VARIABLES ""
+set_interface_property irq SVD_ADDRESS_GROUP ""
+
+add_interface_port irq irq irq Output 1
+
@@ -19,138 +19,246 @@
 
 #include <stdint.h>          // C99 integer types -- uint32_t
 #include <stdbool.h>         // bool
-#include <fcntl.h>           // open
-#include <sys/mman.h>        // mmap
-#include <unistd.h>          // close
+#include <stdlib.h>          // calloc, free
 #include "../address_map.h"  // address map
+#include "../lw_bridge.h"    // lw bridge
 #include "gpio_ip.h"         // gpio
 #include "gpio_regs.h"       // registers
+#ifdef VIRTUAL_DE1SOC
+#include "../VIRTUAL/virtual_bus.h" // virtual bus
+#endif
+
+struct gpio_dev
+{
+    uint32_t *base;          // window in the bridge mapping
+    uint32_t offset;         // offset in the light-weight aperature
+};
 
 //-----------------------------------------------------------------------------
 // Global variables
 //-----------------------------------------------------------------------------
 
-uint32_t *base = NULL;
+// Instance used by the single-instance calls
+static gpio_t *gpio0 = NULL;
 
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
 
-bool gpioOpen()
+// Register accesses go through the virtual bus to de1soc_sim when built
+// with VIRTUAL_DE1SOC
+static inline uint32_t readReg(gpio_t *gpio, uint8_t ofs)
+{
+#ifdef VIRTUAL_DE1SOC
+    return vbusRead(gpio->offset + ofs * 4);
+#else
+    return *(gpio->base+ofs);
+#endif
+}
+
+static inline void writeReg(gpio_t *gpio, uint8_t ofs, uint32_t data)
 {
-    // Open /dev/mem
-    int file = open("/dev/mem", O_RDWR | O_SYNC);
-    bool bOK = (file >= 0);
-    if (bOK)
+#ifdef VIRTUAL_DE1SOC
+    vbusWrite(gpio->offset + ofs * 4, data);
+#else
+    *(gpio->base+ofs) = data;
+#endif
+}
+
+gpio_t *gpioDevOpen(uint32_t offset)
+{
+    gpio_t *gpio = calloc(1, sizeof(gpio_t));
+    if (gpio == NULL) return NULL;
+    gpio->offset = offset;
+    if (!lwBridgeMap(offset, SPAN_IN_BYTES, &gpio->base))
     {
-        // Create a map from the physical memory location of
-        // /dev/mem at an offset to LW avalon interface
-        // with an aperature of SPAN_IN_BYTES bytes
-        // to any location in the virtual 32-bit memory space of the process
-        base = mmap(NULL, SPAN_IN_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED,
-                    file, LW_BRIDGE_BASE + GPIO_BASE_OFFSET);
-        bOK = (base != MAP_FAILED);
-
-        // Close /dev/mem
-        close(file);
+        free(gpio);
+        return NULL;
     }
-    return bOK;
+    return gpio;
 }
 
-void selectPinPushPullOutput(uint8_t pin)
+void gpioDevClose(gpio_t *gpio)
+{
+    if (gpio == NULL) return;
+    lwBridgeUnmap();
+    free(gpio);
+}
+
+void gpioDevSelectPinPushPullOutput(gpio_t *gpio, uint8_t pin)
 {
     uint32_t mask = 1 << pin;
-    *(base+OFS_OD)  &= ~mask;
-    *(base+OFS_OUT) |=  mask;
+    writeReg(gpio, OFS_OD, readReg(gpio, OFS_OD) & ~mask);
+    writeReg(gpio, OFS_OUT, readReg(gpio, OFS_OUT) | mask);
 }
 
-void selectPinOpenDrainOutput(uint8_t pin)
+void gpioDevSelectPinOpenDrainOutput(gpio_t *gpio, uint8_t pin)
 {
     uint32_t mask = 1 << pin;
-    *(base+OFS_OD)  |= mask;
-    *(base+OFS_OUT) |= mask;
+    writeReg(gpio, OFS_OD, readReg(gpio, OFS_OD) | mask);
+    writeReg(gpio, OFS_OUT, readReg(gpio, OFS_OUT) | mask);
 }
 
-void selectPinDigitalInput(uint8_t pin)
+void gpioDevSelectPinDigitalInput(gpio_t *gpio, uint8_t pin)
 {
     uint32_t mask = 1 << pin;
-    *(base+OFS_OUT) &= ~mask;
+    writeReg(gpio, OFS_OUT, readReg(gpio, OFS_OUT) & ~mask);
 }
 
-void selectPinInterruptRisingEdge(uint8_t pin)
+void gpioDevSelectPinInterruptRisingEdge(gpio_t *gpio, uint8_t pin)
 {
     uint32_t mask = 1 << pin;
-    *(base+OFS_INT_POSITIVE)  |=  mask;
-    *(base+OFS_INT_NEGATIVE)  &= ~mask;
-    *(base+OFS_INT_EDGE_MODE) |=  mask;
+    writeReg(gpio, OFS_INT_POSITIVE, readReg(gpio, OFS_INT_POSITIVE) | mask);
+    writeReg(gpio, OFS_INT_NEGATIVE, readReg(gpio, OFS_INT_NEGATIVE) & ~mask);
+    writeReg(gpio, OFS_INT_EDGE_MODE, readReg(gpio, OFS_INT_EDGE_MODE) | mask);
 }
 
-void selectPinInterruptFallingEdge(uint8_t pin)
+void gpioDevSelectPinInterruptFallingEdge(gpio_t *gpio, uint8_t pin)
 {
     uint32_t mask = 1 << pin;
-    *(base+OFS_INT_POSITIVE)  &= ~mask;
-    *(base+OFS_INT_NEGATIVE)  |=  mask;
-    *(base+OFS_INT_EDGE_MODE) |=  mask;
+    writeReg(gpio, OFS_INT_POSITIVE, readReg(gpio, OFS_INT_POSITIVE) & ~mask);
+    writeReg(gpio, OFS_INT_NEGATIVE, readReg(gpio, OFS_INT_NEGATIVE) | mask);
+    writeReg(gpio, OFS_INT_EDGE_MODE, readReg(gpio, OFS_INT_EDGE_MODE) | mask);
 }
 
-void selectPinInterruptBothEdges(uint8_t pin)
+void gpioDevSelectPinInterruptBothEdges(gpio_t *gpio, uint8_t pin)
 {
     uint32_t mask = 1 << pin;
-    *(base+OFS_INT_POSITIVE)  |= mask;
-    *(base+OFS_INT_NEGATIVE)  |= mask;
-    *(base+OFS_INT_EDGE_MODE) |= mask;
+    writeReg(gpio, OFS_INT_POSITIVE, readReg(gpio, OFS_INT_POSITIVE) | mask);
+    writeReg(gpio, OFS_INT_NEGATIVE, readReg(gpio, OFS_INT_NEGATIVE) | mask);
+    writeReg(gpio, OFS_INT_EDGE_MODE, readReg(gpio, OFS_INT_EDGE_MODE) | mask);
 }
 
-void selectPinInterruptHighLevel(uint8_t pin)
+void gpioDevSelectPinInterruptHighLevel(gpio_t *gpio, uint8_t pin)
 {
     uint32_t mask = 1 << pin;
-    *(base+OFS_INT_POSITIVE)  |=  mask;
-    *(base+OFS_INT_NEGATIVE)  &= ~mask;
-    *(base+OFS_INT_EDGE_MODE) &= ~mask;
+    writeReg(gpio, OFS_INT_POSITIVE, readReg(gpio, OFS_INT_POSITIVE) | mask);
+    writeReg(gpio, OFS_INT_NEGATIVE, readReg(gpio, OFS_INT_NEGATIVE) & ~mask);
+    writeReg(gpio, OFS_INT_EDGE_MODE, readReg(gpio, OFS_INT_EDGE_MODE) & ~mask);
 }
 
-void selectPinInterruptLowLevel(uint8_t pin)
+void gpioDevSelectPinInterruptLowLevel(gpio_t *gpio, uint8_t pin)
 {
     uint32_t mask = 1 << pin;
-    *(base+OFS_INT_POSITIVE)  &= ~mask;
-    *(base+OFS_INT_NEGATIVE)  |=  mask;
-    *(base+OFS_INT_EDGE_MODE) &= ~mask;
+    writeReg(gpio, OFS_INT_POSITIVE, readReg(gpio, OFS_INT_POSITIVE) & ~mask);
+    writeReg(gpio, OFS_INT_NEGATIVE, readReg(gpio, OFS_INT_NEGATIVE) | mask);
+    writeReg(gpio, OFS_INT_EDGE_MODE, readReg(gpio, OFS_INT_EDGE_MODE) & ~mask);
 }
 
-void enablePinInterrupt(uint8_t pin)
+void gpioDevEnablePinInterrupt(gpio_t *gpio, uint8_t pin)
 {
     uint32_t mask = 1 << pin;
-    *(base+OFS_INT_ENABLE) |= mask;
+    writeReg(gpio, OFS_INT_ENABLE, readReg(gpio, OFS_INT_ENABLE) | mask);
 }
 
-void disablePinInterrupt(uint8_t pin)
+void gpioDevDisablePinInterrupt(gpio_t *gpio, uint8_t pin)
 {
     uint32_t mask = 1 << pin;
-    *(base+OFS_INT_ENABLE) &= ~mask;
+    writeReg(gpio, OFS_INT_ENABLE, readReg(gpio, OFS_INT_ENABLE) & ~mask);
 }
 
-void setPinValue(uint8_t pin, bool value)
+void gpioDevSetPinValue(gpio_t *gpio, uint8_t pin, bool value)
 {
     uint32_t mask = 1 << pin;
     if (value)
-        *(base+OFS_DATA) |= mask;
+        writeReg(gpio, OFS_DATA, readReg(gpio, OFS_DATA) | mask);
     else
-        *(base+OFS_DATA) &= ~mask;
+        writeReg(gpio, OFS_DATA, readReg(gpio, OFS_DATA) & ~mask);
 }
 
-bool getPinValue(uint8_t pin)
+bool gpioDevGetPinValue(gpio_t *gpio, uint8_t pin)
 {
-    uint32_t value = *(base+OFS_DATA);
+    uint32_t value = readReg(gpio, OFS_DATA);
     return (value >> pin) & 1;
 }
 
+void gpioDevSetPortValue(gpio_t *gpio, uint32_t value)
+{
+     writeReg(gpio, OFS_DATA, value);
+}
+
+uint32_t gpioDevGetPortValue(gpio_t *gpio)
+{
+    uint32_t value = readReg(gpio, OFS_DATA);
+    return value;
+}
+
+//-----------------------------------------------------------------------------
+// Single-instance calls on the core at GPIO_BASE_OFFSET
+//-----------------------------------------------------------------------------
+
+bool gpioOpen()
+{
+    if (gpio0 == NULL) gpio0 = gpioDevOpen(GPIO_BASE_OFFSET);
+    return gpio0 != NULL;
+}
+
+void selectPinPushPullOutput(uint8_t pin)
+{
+    gpioDevSelectPinPushPullOutput(gpio0, pin);
+}
+
+void selectPinOpenDrainOutput(uint8_t pin)
+{
+    gpioDevSelectPinOpenDrainOutput(gpio0, pin);
+}
+
+void selectPinDigitalInput(uint8_t pin)
+{
+    gpioDevSelectPinDigitalInput(gpio0, pin);
+}
+
+void selectPinInterruptRisingEdge(uint8_t pin)
+{
+    gpioDevSelectPinInterruptRisingEdge(gpio0, pin);
+}
+
+void selectPinInterruptFallingEdge(uint8_t pin)
+{
+    gpioDevSelectPinInterruptFallingEdge(gpio0, pin);
+}
+
+void selectPinInterruptBothEdges(uint8_t pin)
+{
+    gpioDevSelectPinInterruptBothEdges(gpio0, pin);
+}
+
+void selectPinInterruptHighLevel(uint8_t pin)
+{
+    gpioDevSelectPinInterruptHighLevel(gpio0, pin);
+}
+
+void selectPinInterruptLowLevel(uint8_t pin)
+{
+    gpioDevSelectPinInterruptLowLevel(gpio0, pin);
+}
+
+void enablePinInterrupt(uint8_t pin)
+{
+    gpioDevEnablePinInterrupt(gpio0, pin);
+}
+
+void disablePinInterrupt(uint8_t pin)
+{
+    gpioDevDisablePinInterrupt(gpio0, pin);
+}
+
+void setPinValue(uint8_t pin, bool value)
+{
+    gpioDevSetPinValue(gpio0, pin, value);
+}
+
+bool getPinValue(uint8_t pin)
+{
+    return gpioDevGetPinValue(gpio0, pin);
+}
+
 void setPortValue(uint32_t value)
 {
-     *(base+OFS_DATA) = value;
+    gpioDevSetPortValue(gpio0, value);
 }
 
 uint32_t getPortValue()
 {
-    uint32_t value = *(base+OFS_DATA);
-    return value;
+    return gpioDevGetPortValue(gpio0);
 }
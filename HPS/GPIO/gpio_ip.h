@@ -23,10 +23,38 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+// Handle for one GPIO IP instance
+typedef struct gpio_dev gpio_t;
+
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
 
+// Instances at any offset in the light-weight aperature (address_map.h or
+// lwBridgeFindCore), all sharing one mapping of the bridge
+gpio_t *gpioDevOpen(uint32_t offset);
+void gpioDevClose(gpio_t *gpio);
+
+void gpioDevSelectPinPushPullOutput(gpio_t *gpio, uint8_t pin);
+void gpioDevSelectPinOpenDrainOutput(gpio_t *gpio, uint8_t pin);
+void gpioDevSelectPinDigitalInput(gpio_t *gpio, uint8_t pin);
+
+void gpioDevSelectPinInterruptRisingEdge(gpio_t *gpio, uint8_t pin);
+void gpioDevSelectPinInterruptFallingEdge(gpio_t *gpio, uint8_t pin);
+void gpioDevSelectPinInterruptBothEdges(gpio_t *gpio, uint8_t pin);
+void gpioDevSelectPinInterruptHighLevel(gpio_t *gpio, uint8_t pin);
+void gpioDevSelectPinInterruptLowLevel(gpio_t *gpio, uint8_t pin);
+void gpioDevEnablePinInterrupt(gpio_t *gpio, uint8_t pin);
+void gpioDevDisablePinInterrupt(gpio_t *gpio, uint8_t pin);
+
+void gpioDevSetPinValue(gpio_t *gpio, uint8_t pin, bool value);
+bool gpioDevGetPinValue(gpio_t *gpio, uint8_t pin);
+void gpioDevSetPortValue(gpio_t *gpio, uint32_t value);
+uint32_t gpioDevGetPortValue(gpio_t *gpio);
+
+// The core at GPIO_BASE_OFFSET
+bool gpioOpen();
+
 void selectPinPushPullOutput(uint8_t pin);
 void selectPinOpenDrainOutput(uint8_t pin);
 void selectPinDigitalInput(uint8_t pin);
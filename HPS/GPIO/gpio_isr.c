@@ -15,15 +15,35 @@
 //   Mapped to offset of 0 in light-weight MM interface aperature
 //   IRQ80 is used as the interrupt interface to the HPS
 
+// /dev/gpio_irq lets user programs sleep on IRQ80:
+//   write() a 32-bit pin mask to arm those pins for falling edge interrupts
+//   (active low interrupt lines such as the MCP23S08 INT output)
+//   read() blocks until an armed pin interrupts and returns the 32-bit flags
+//   poll()/select() can be used to wait with a timeout
+// A pin stays armed until the file that armed it is closed, and is armed by
+// one open file at a time
+// Only armed pins are read and cleared here, so other drivers sharing IRQ80
+// see their own flags. Such drivers claim their pins with gpioIrqClaim(),
+// which fails while a pin is armed, and arming a claimed pin fails with
+// EBUSY. gpio_expander_driver claims GPIO_1[31], so the MCP23S08 library's
+// gpioExpanderWaitForChange() and the kernel driver are mutually exclusive.
+
 //-----------------------------------------------------------------------------
 
 #include <linux/kernel.h>
 #include <linux/module.h>
 #include <linux/interrupt.h>
 #include <linux/init.h>
+#include <linux/fs.h>
+#include <linux/miscdevice.h>
+#include <linux/poll.h>
+#include <linux/wait.h>
+#include <linux/uaccess.h>
 #include <asm/io.h>           // iowrite, ioread (platform specific)
-#include "address_map.h"
+#include <linux/mutex.h>
+#include "../address_map.h"
 #include "gpio_regs.h"
+#include "gpio_isr.h"
 
 //-----------------------------------------------------------------------------
 // Global variables
@@ -31,6 +51,13 @@
 
 uint32_t *base = NULL;
 
+static DECLARE_WAIT_QUEUE_HEAD(gpio_wait);
+static DEFINE_SPINLOCK(gpio_lock);
+static DEFINE_MUTEX(claim_lock);
+static uint32_t pending = 0;
+static uint32_t armed = 0;
+static uint32_t claimed = 0;
+
 //-----------------------------------------------------------------------------
 // Kernel module information
 //-----------------------------------------------------------------------------
@@ -46,25 +73,154 @@ MODULE_DESCRIPTION("GPIO IP Interrupt Handler");
 irq_handler_t isr(int irq, void *dev_id, struct pt_regs *regs)
 {
     uint32_t value;
-    printk(KERN_INFO "GPIO IP IRQ (IRQ80) occurred\n");
 
-    // Disable all interrupts
-    iowrite32(0x00000000, base + OFS_INT_ENABLE);
+    // Read and clear the active interrupts on armed pins
+    value = ioread32(base + OFS_INT_STATUS_CLEAR) & READ_ONCE(armed);
+    if (value == 0)
+        return (irq_handler_t)IRQ_NONE;
+    iowrite32(value, base + OFS_INT_STATUS_CLEAR);
+
+    // Hand the flags to any reader of /dev/gpio_irq
+    spin_lock(&gpio_lock);
+    pending |= value;
+    spin_unlock(&gpio_lock);
+    wake_up_interruptible(&gpio_wait);
 
-    // Display active interrupts
-    value = ioread32(base + OFS_INT_STATUS_CLEAR);
-    printk("flags: %08x\n", value);
+    return (irq_handler_t)IRQ_HANDLED;
+}
 
-    // Clear interrupt flags
-    iowrite32(0xFFFFFFFF, base + OFS_INT_STATUS_CLEAR);
+//-----------------------------------------------------------------------------
+// Character Device
+//-----------------------------------------------------------------------------
 
-    // Display active interrupts
-    value = ioread32(base + OFS_INT_STATUS_CLEAR);
-    printk("flags: %08x\n", value);
+static uint32_t takePending(void)
+{
+    uint32_t value;
+    unsigned long flags;
+    spin_lock_irqsave(&gpio_lock, flags);
+    value = pending;
+    pending = 0;
+    spin_unlock_irqrestore(&gpio_lock, flags);
+    return value;
+}
 
-    return (irq_handler_t)IRQ_HANDLED;
+static ssize_t gpio_irq_read(struct file *file, char __user *buffer, size_t count, loff_t *offset)
+{
+    uint32_t value;
+    int result;
+
+    if (count < sizeof(uint32_t))
+        return -EINVAL;
+    if ((file->f_flags & O_NONBLOCK) && READ_ONCE(pending) == 0)
+        return -EAGAIN;
+    result = wait_event_interruptible(gpio_wait, READ_ONCE(pending) != 0);
+    if (result != 0)
+        return result;
+    value = takePending();
+    if (copy_to_user(buffer, &value, sizeof(value)))
+        return -EFAULT;
+    return sizeof(value);
+}
+
+// The pins armed through a file are kept in its private_data
+static int gpio_irq_open(struct inode *inode, struct file *file)
+{
+    file->private_data = NULL;
+    return 0;
+}
+
+static ssize_t gpio_irq_write(struct file *file, const char __user *buffer, size_t count, loff_t *offset)
+{
+    uint32_t mask, own;
+
+    if (count != sizeof(uint32_t))
+        return -EINVAL;
+    if (copy_from_user(&mask, buffer, sizeof(mask)))
+        return -EFAULT;
+
+    mutex_lock(&claim_lock);
+    own = (uint32_t)(uintptr_t)file->private_data;
+    if (mask & (claimed | (armed & ~own)))
+    {
+        mutex_unlock(&claim_lock);
+        return -EBUSY;
+    }
+
+    // Falling edge on the armed pins, discarding anything already latched
+    iowrite32(ioread32(base + OFS_INT_EDGE_MODE) | mask, base + OFS_INT_EDGE_MODE);
+    iowrite32(ioread32(base + OFS_INT_NEGATIVE) | mask, base + OFS_INT_NEGATIVE);
+    iowrite32(ioread32(base + OFS_INT_POSITIVE) & ~mask, base + OFS_INT_POSITIVE);
+    iowrite32(mask, base + OFS_INT_STATUS_CLEAR);
+    WRITE_ONCE(armed, armed | mask);
+    iowrite32(ioread32(base + OFS_INT_ENABLE) | mask, base + OFS_INT_ENABLE);
+    file->private_data = (void *)(uintptr_t)(own | mask);
+    mutex_unlock(&claim_lock);
+    return count;
+}
+
+static int gpio_irq_release(struct inode *inode, struct file *file)
+{
+    uint32_t own = (uint32_t)(uintptr_t)file->private_data;
+
+    mutex_lock(&claim_lock);
+    iowrite32(ioread32(base + OFS_INT_ENABLE) & ~own, base + OFS_INT_ENABLE);
+    WRITE_ONCE(armed, armed & ~own);
+    mutex_unlock(&claim_lock);
+    return 0;
+}
+
+static unsigned int gpio_irq_poll(struct file *file, poll_table *wait)
+{
+    poll_wait(file, &gpio_wait, wait);
+    return READ_ONCE(pending) ? (POLLIN | POLLRDNORM) : 0;
 }
 
+static const struct file_operations gpio_irq_fops =
+{
+    .owner = THIS_MODULE,
+    .open = gpio_irq_open,
+    .read = gpio_irq_read,
+    .write = gpio_irq_write,
+    .poll = gpio_irq_poll,
+    .release = gpio_irq_release,
+    .llseek = no_llseek,
+};
+
+static struct miscdevice gpio_irq_miscdev =
+{
+    .minor = MISC_DYNAMIC_MINOR,
+    .name = "gpio_irq",
+    .fops = &gpio_irq_fops,
+};
+
+//-----------------------------------------------------------------------------
+// Pin Claims
+//-----------------------------------------------------------------------------
+
+// Reserves pins for a driver that handles their interrupts itself, so they
+// cannot be armed through /dev/gpio_irq; fails with -EBUSY if any of them
+// is armed or claimed already
+int gpioIrqClaim(uint32_t mask)
+{
+    int result = 0;
+    mutex_lock(&claim_lock);
+    if (mask & (armed | claimed))
+        result = -EBUSY;
+    else
+        claimed |= mask;
+    mutex_unlock(&claim_lock);
+    return result;
+}
+EXPORT_SYMBOL(gpioIrqClaim);
+
+void gpioIrqRelease(uint32_t mask)
+{
+    mutex_lock(&claim_lock);
+    claimed &= ~mask;
+    mutex_unlock(&claim_lock);
+}
+EXPORT_SYMBOL(gpioIrqRelease);
+
 //-----------------------------------------------------------------------------
 // Initialization
 //-----------------------------------------------------------------------------
@@ -76,15 +232,25 @@ static int __init initialize_module(void)
     // Physical to virtual memory map to access gpio registers
     base = (uint32_t*)ioremap_nocache(LW_BRIDGE_BASE + GPIO_BASE_OFFSET,
                                       SPAN_IN_BYTES);
+    if (base == NULL)
+        return -ENODEV;
 
     // Register ISR
     result = request_irq(GPIO_IRQ, (irq_handler_t)isr, IRQF_SHARED,
                          "GPIO IP", (irq_handler_t)isr);
+    if (result != 0)
+        return result;
+
+    // Create /dev/gpio_irq
+    result = misc_register(&gpio_irq_miscdev);
+    if (result != 0)
+        free_irq(GPIO_IRQ, (irq_handler_t)isr);
     return result;
 }
 
 static void __exit exit_module(void)
 {
+    misc_deregister(&gpio_irq_miscdev);
     free_irq(GPIO_IRQ, (irq_handler_t)isr);
 }
 
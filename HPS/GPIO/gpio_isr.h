@@ -0,0 +1,32 @@
+// GPIO IP Example
+// GPIO IP ISR Kernel Interface (gpio_isr.h)
+// Jason Losh
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: DE1-SoC Board
+
+// Hardware configuration:
+// GPIO Port:
+//   GPIO_1[31-0] is used as a general purpose GPIO port
+// HPS interface:
+//   Mapped to offset of 0 in light-weight MM interface aperature
+//   IRQ80 is used as the interrupt interface to the HPS
+
+//-----------------------------------------------------------------------------
+
+#ifndef GPIO_ISR_H_
+#define GPIO_ISR_H_
+
+#include <linux/types.h>
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+int gpioIrqClaim(uint32_t mask);
+void gpioIrqRelease(uint32_t mask);
+
+#endif
@@ -0,0 +1,65 @@
+// GPIO IP Example
+// GPIO IP Library Register Fields (gpio_regs.hpp)
+// Jason Losh
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: DE1-SoC Board
+
+// Hardware configuration:
+// GPIO IP core connected to light-weight Avalon bus
+
+// The registers of gpio_regs.h as ../mmio_reg.hpp types; every register
+// has one bit per pin, so several pins change with one store, e.g.
+//   Out::modify(base, pin::Out::at(3, 1) | pin::Out::at(4, 1));
+
+//-----------------------------------------------------------------------------
+
+#ifndef GPIO_REGS_HPP_
+#define GPIO_REGS_HPP_
+
+#include <stdint.h>
+#include "../mmio_reg.hpp"
+
+namespace gpio_regs
+{
+
+using mmio::Register;
+using mmio::FieldArray;
+
+//-----------------------------------------------------------------------------
+// Registers
+//-----------------------------------------------------------------------------
+
+struct Core;                 // tag of this core
+
+typedef Register<Core, 0> Data;
+typedef Register<Core, 1> Out;
+typedef Register<Core, 2> Od;
+typedef Register<Core, 3> IntEnable;
+typedef Register<Core, 4> IntPositive;
+typedef Register<Core, 5> IntNegative;
+typedef Register<Core, 6> IntEdgeMode;
+typedef Register<Core, 7> IntStatusClear;
+
+//-----------------------------------------------------------------------------
+// Fields
+//-----------------------------------------------------------------------------
+
+namespace pin
+{
+    typedef FieldArray<Data, 0, 1, 1, 32>           Data;
+    typedef FieldArray<Out, 0, 1, 1, 32>            Out;
+    typedef FieldArray<Od, 0, 1, 1, 32>             Od;
+    typedef FieldArray<IntEnable, 0, 1, 1, 32>      IntEnable;
+    typedef FieldArray<IntPositive, 0, 1, 1, 32>    IntPositive;
+    typedef FieldArray<IntNegative, 0, 1, 1, 32>    IntNegative;
+    typedef FieldArray<IntEdgeMode, 0, 1, 1, 32>    IntEdgeMode;
+    typedef FieldArray<IntStatusClear, 0, 1, 1, 32> IntStatusClear;
+}
+
+}
+
+#endif
@@ -19,80 +19,158 @@
 
 #include <stdint.h>          // C99 integer types -- uint32_t
 #include <stdbool.h>         // bool
-#include <fcntl.h>           // open
-#include <sys/mman.h>        // mmap
-#include <unistd.h>          // close
+#include <stdlib.h>          // calloc, free
 #include "address_map.h"     // address map
+#include "../lw_bridge.h"    // lw bridge
 #include "qe_ip.h"           // qe
 #include "qe_regs.h"         // registers
+#ifdef VIRTUAL_DE1SOC
+#include "../VIRTUAL/virtual_bus.h" // virtual bus
+#endif
+
+struct qe_dev
+{
+    uint32_t *base;          // window in the bridge mapping
+    uint32_t offset;         // offset in the light-weight aperature
+};
 
 //-----------------------------------------------------------------------------
 // Global variables
 //-----------------------------------------------------------------------------
 
-uint32_t *base = NULL;
+// Instance used by the single-instance calls
+static qe_t *qe0 = NULL;
 
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
 
-bool qeOpen()
+// Register accesses go through the virtual bus to de1soc_sim when built
+// with VIRTUAL_DE1SOC
+static inline uint32_t readReg(qe_t *qe, uint8_t ofs)
+{
+#ifdef VIRTUAL_DE1SOC
+    return vbusRead(qe->offset + ofs * 4);
+#else
+    return *(qe->base+ofs);
+#endif
+}
+
+static inline void writeReg(qe_t *qe, uint8_t ofs, uint32_t data)
 {
-    // Open /dev/mem
-    int file = open("/dev/mem", O_RDWR | O_SYNC);
-    bool bOK = (file >= 0);
-    if (bOK)
+#ifdef VIRTUAL_DE1SOC
+    vbusWrite(qe->offset + ofs * 4, data);
+#else
+    *(qe->base+ofs) = data;
+#endif
+}
+
+qe_t *qeDevOpen(uint32_t offset)
+{
+    qe_t *qe = calloc(1, sizeof(qe_t));
+    if (qe == NULL) return NULL;
+    qe->offset = offset;
+    if (!lwBridgeMap(offset, QE_SPAN_IN_BYTES, &qe->base))
     {
-        // Create a map from the physical memory location of
-        // /dev/mem at an offset to LW avalon interface
-        // with an aperature of QE_SPAN_IN_BYTES bytes
-        // to any location in the virtual 32-bit memory space of the process
-        base = mmap(NULL, QE_SPAN_IN_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED,
-                    file, LW_BRIDGE_BASE + QE_BASE_OFFSET);
-        bOK = (base != MAP_FAILED);
-
-        // Close /dev/mem
-        close(file);
+        free(qe);
+        return NULL;
     }
-    return bOK;
+    return qe;
+}
+
+void qeDevClose(qe_t *qe)
+{
+    if (qe == NULL) return;
+    lwBridgeUnmap();
+    free(qe);
+}
+
+void qeDevEnableChannel(qe_t *qe, uint8_t channel)
+{
+    writeReg(qe, OFS_CONTROL, readReg(qe, OFS_CONTROL) | (1 << channel));
+}
+
+void qeDevDisableChannel(qe_t *qe, uint8_t channel)
+{
+    writeReg(qe, OFS_CONTROL, readReg(qe, OFS_CONTROL) & ~(1 << channel));
+}
+
+void qeDevEnableChannelSwap(qe_t *qe, uint8_t channel)
+{
+    writeReg(qe, OFS_CONTROL, readReg(qe, OFS_CONTROL) | (4 << channel));
+}
+
+void qeDevDisableChannelSwap(qe_t *qe, uint8_t channel)
+{
+    writeReg(qe, OFS_CONTROL, readReg(qe, OFS_CONTROL) & ~(4 << channel));
+}
+
+void qeDevSetPosition(qe_t *qe, uint8_t channel, int32_t position)
+{
+    writeReg(qe, OFS_POSITION0+channel*2, position);
+}
+
+int32_t qeDevGetPosition(qe_t *qe, uint8_t channel)
+{
+    return readReg(qe, OFS_POSITION0+channel*2);
+}
+
+void qeDevSetVelocityTimebase(qe_t *qe, uint32_t period)
+{
+    writeReg(qe, OFS_PERIOD, period);
+}
+
+int32_t qeDevGetVelocity(qe_t *qe, uint8_t channel)
+{
+    return readReg(qe, OFS_VELOCITY0+channel*2);
+}
+
+//-----------------------------------------------------------------------------
+// Single-instance calls on the core at QE_BASE_OFFSET
+//-----------------------------------------------------------------------------
+
+bool qeOpen()
+{
+    if (qe0 == NULL) qe0 = qeDevOpen(QE_BASE_OFFSET);
+    return qe0 != NULL;
 }
 
 void enableChannel(uint8_t channel)
 {
-    *(base+OFS_CONTROL) |= 1 << channel;
+    qeDevEnableChannel(qe0, channel);
 }
 
 void disableChannel(uint8_t channel)
 {
-    *(base+OFS_CONTROL) &= ~(1 << channel);
+    qeDevDisableChannel(qe0, channel);
 }
 
 void enableChannelSwap(uint8_t channel)
 {
-    *(base+OFS_CONTROL) |= 4 << channel;
+    qeDevEnableChannelSwap(qe0, channel);
 }
 
 void disableChannelSwap(uint8_t channel)
 {
-    *(base+OFS_CONTROL) &= ~(4 << channel);
+    qeDevDisableChannelSwap(qe0, channel);
 }
 
 void setPosition(uint8_t channel, int32_t position)
 {
-    *(base+OFS_POSITION0+channel*2) = position;
+    qeDevSetPosition(qe0, channel, position);
 }
 
 int32_t getPosition(uint8_t channel)
 {
-    return *(base+OFS_POSITION0+channel*2);
+    return qeDevGetPosition(qe0, channel);
 }
 
 void setVelocityTimebase(uint32_t period)
 {
-    *(base+OFS_PERIOD) = period;
+    qeDevSetVelocityTimebase(qe0, period);
 }
 
 int32_t getVelocity(uint8_t channel)
 {
-    return *(base+OFS_VELOCITY0+channel*2);
+    return qeDevGetVelocity(qe0, channel);
 }
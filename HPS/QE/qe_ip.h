@@ -23,10 +23,30 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+// Handle for one QE IP instance
+typedef struct qe_dev qe_t;
+
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
 
+// Instances at any offset in the light-weight aperature (address_map.h or
+// lwBridgeFindCore), all sharing one mapping of the bridge
+qe_t *qeDevOpen(uint32_t offset);
+void qeDevClose(qe_t *qe);
+
+void qeDevEnableChannel(qe_t *qe, uint8_t channel);
+void qeDevDisableChannel(qe_t *qe, uint8_t channel);
+void qeDevEnableChannelSwap(qe_t *qe, uint8_t channel);
+void qeDevDisableChannelSwap(qe_t *qe, uint8_t channel);
+
+void qeDevSetPosition(qe_t *qe, uint8_t channel, int32_t position);
+int32_t qeDevGetPosition(qe_t *qe, uint8_t channel);
+
+void qeDevSetVelocityTimebase(qe_t *qe, uint32_t period);
+int32_t qeDevGetVelocity(qe_t *qe, uint8_t channel);
+
+// The core at QE_BASE_OFFSET
 bool qeOpen();
 
 void enableChannel(uint8_t channel);
@@ -0,0 +1,58 @@
+// QE IP Example
+// QE IP Library Register Fields (qe_regs.hpp)
+// Jason Losh
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: DE1-SoC Board
+
+// Hardware configuration:
+// QE IP core connected to light-weight Avalon bus
+
+// The registers of qe_regs.h as ../mmio_reg.hpp types, e.g. enabling both
+// channels with channel 1 swapped is one store:
+//   Control::write(base, control::Enable::at(0, 1) | control::Enable::at(1, 1)
+//                  | control::Swap::at(1, 1));
+
+//-----------------------------------------------------------------------------
+
+#ifndef QE_REGS_HPP_
+#define QE_REGS_HPP_
+
+#include <stdint.h>
+#include "../mmio_reg.hpp"
+
+namespace qe_regs
+{
+
+using mmio::Register;
+using mmio::FieldArray;
+
+//-----------------------------------------------------------------------------
+// Registers
+//-----------------------------------------------------------------------------
+
+struct Core;                 // tag of this core
+
+typedef Register<Core, 0> Control;
+typedef Register<Core, 1> Period;
+template <unsigned Channel>
+using Position = Register<Core, 4 + Channel * 2>;
+template <unsigned Channel>
+using Velocity = Register<Core, 5 + Channel * 2>;
+
+//-----------------------------------------------------------------------------
+// Fields
+//-----------------------------------------------------------------------------
+
+namespace control
+{
+    typedef FieldArray<Control, 0, 1, 1, 2> Enable;
+    typedef FieldArray<Control, 2, 1, 1, 2> Swap;
+}
+
+}
+
+#endif
@@ -15,6 +15,12 @@
 // HPS interface:
 //   Mapped to offset of 0 in light-weight MM interface aperature
 //   IRQ80 is used as the interrupt interface to the HPS
+// MCP23S08 INT:
+//   Wired to GPIO_1[31], a falling edge interrupt pin of the GPIO IP
+
+// The library talks to the expander over /dev/mem, so it cannot be used
+// while gpio_expander_driver is loaded; the driver caches the registers this
+// library rewrites and claims GPIO_1[31] from gpio_isr
 
 //=============================================================================
 
@@ -25,88 +31,390 @@
 #include "../spi_ip.h"          // spi
 #include "gpio_expander_regs.h" // registers
 #include <unistd.h>
+#include <fcntl.h>              // open
+#include <errno.h>              // errno
+#include <poll.h>               // poll
 
 #define CLOCK_SPEED 5000000 // 5MHz
 #define WORDSIZE 24 // 24-Bit
+#define INT_GPIO_PIN 31 // GPIO_1 pin wired to the MCP23S08 INT output
+#define POLL_INTERVAL_MS 10 // GPIO read interval without /dev/gpio_irq
+
+// Registers held in the write-through cache (IODIR-IOCON, GPPU and OLAT)
+#define CACHED_REGS ((1 << (IODIR >> 8)) | (1 << (IPOL >> 8)) | (1 << (GPINTEN >> 8)) | \
+                     (1 << (DEFVAL >> 8)) | (1 << (INTCON >> 8)) | (1 << (IOCON >> 8)) | \
+                     (1 << (GPPU >> 8)) | (1 << (OLAT >> 8)))
+
+//=============================================================================
+// Global variables
+//=============================================================================
+
+// Register cache indexed by register address; a register is loaded from the
+// chip the first time it is needed and kept up to date by every write
+uint8_t regCache[(OLAT >> 8) + 1];
+uint16_t regCacheValid = 0;
+
+// Output batching: between gpioExpanderBegin() and the matching
+// gpioExpanderCommit(), OLAT changes only update the cache
+uint8_t batchDepth = 0;
+bool olatPending = false;
+
+int irqFile = -1;
+bool driverLoaded = false;   // GPIO_1[31] is claimed by gpio_expander_driver
 
 //=============================================================================
 // Subroutines
 //=============================================================================
 
+// One 24-bit transaction, storing the byte clocked in during the data phase
+// Returns false if the frame was lost
+static bool transaction(uint32_t command, uint8_t *data)
+{
+    uint32_t rx = 0;
+    bool bOK = spiTransfer(&command, &rx, 1);
+    if (bOK) *data = rx & 0xFF;
+    return bOK;
+}
+
+// A lost read leaves data and the cache alone
+static bool readRegister(uint32_t reg, uint8_t *data)
+{
+    if (regCacheValid & (1 << (reg >> 8)))
+    {
+        *data = regCache[reg >> 8];
+        return true;
+    }
+    if (!transaction(READ | reg | BLANK, data)) return false;
+    if (CACHED_REGS & (1 << (reg >> 8)))
+    {
+        regCache[reg >> 8] = *data;
+        regCacheValid |= (1 << (reg >> 8));
+    }
+    return true;
+}
+
+// A lost write may or may not have reached the chip, so the register is
+// dropped from the cache and read back next time
+static bool writeRegister(uint32_t reg, uint8_t data)
+{
+    uint8_t rx;
+    if (!transaction(WRITE | reg | data, &rx))
+    {
+        regCacheValid &= ~(1 << (reg >> 8));
+        return false;
+    }
+    if (CACHED_REGS & (1 << (reg >> 8)))
+    {
+        regCache[reg >> 8] = data;
+        regCacheValid |= (1 << (reg >> 8));
+    }
+    return true;
+}
+
+// Getters return 0 when the register cannot be read
+static uint8_t readRegisterOrZero(uint32_t reg)
+{
+    uint8_t data = 0;
+    readRegister(reg, &data);
+    return data;
+}
+
+// Read-modify-write of the bits in mask, skipping the write if it would not
+// change the register
+static bool updateRegister(uint32_t reg, uint8_t mask, uint8_t value)
+{
+    uint8_t data = 0, newData;
+    if (reg == OLAT && batchDepth > 0)
+    {
+        if (mask != 0xFF && !readRegister(OLAT, &data)) return false;
+        regCache[OLAT >> 8] = (data & ~mask) | (value & mask);
+        regCacheValid |= (1 << (OLAT >> 8));
+        olatPending = true;
+        return true;
+    }
+    if (mask == 0xFF && !(regCacheValid & (1 << (reg >> 8))))
+        return writeRegister(reg, value);
+    if (!readRegister(reg, &data)) return false;
+    newData = (data & ~mask) | (value & mask);
+    if (newData != data)
+        return writeRegister(reg, newData);
+    return true;
+}
+
+static void updateRegisterBit(uint32_t reg, uint8_t pin, bool value)
+{
+    updateRegister(reg, 1 << pin, value ? 0xFF : 0x00);
+}
+
+// One CS-held frame of 8-bit words: opcode, start address, then count
+// registers with sequential addressing (SEQOP clear)
+static bool registerBurst(uint32_t opcode, uint32_t reg, uint8_t count, const uint8_t *tx, uint8_t *rx)
+{
+    uint32_t txWords[REG_COUNT + 2], rxWords[REG_COUNT + 2];
+    uint8_t i;
+    bool bOK;
+
+    if (count > REG_COUNT) return false;
+    if (!updateRegister(IOCON, IOCON_SEQOP, 0)) return false;
+    txWords[0] = opcode >> 16;
+    txWords[1] = reg >> 8;
+    for (i = 0; i < count; i++)
+        txWords[i + 2] = tx ? tx[i] : BLANK;
+
+    setWordsize(8);
+    setFrameLength(count + 2);
+    bOK = spiTransfer(txWords, rxWords, count + 2);
+    setFrameLength(0);
+    setWordsize(WORDSIZE);
+
+    if (bOK && rx)
+        for (i = 0; i < count; i++)
+            rx[i] = rxWords[i + 2] & 0xFF;
+    return bOK;
+}
+
+// Load the cache from a full register file, keeping a batched OLAT
+static void cacheRegisters(const uint8_t *data)
+{
+    uint8_t i;
+    for (i = 0; i < REG_COUNT; i++)
+    {
+        if (i == (OLAT >> 8) && olatPending)
+            continue;
+        if (CACHED_REGS & (1 << i))
+        {
+            regCache[i] = data[i];
+            regCacheValid |= (1 << i);
+        }
+    }
+}
+
 bool gpioExpanderOpen()
 {
     bool bOK = spiOpen(); // Create SPI Module
     if (bOK) bOK = setStatus(true); // Enable SPI
     if (bOK) bOK = setBRD(CLOCK_SPEED); // Set BRD
     if (bOK) bOK = setWordsize(WORDSIZE); // Set Wordsize
+    gpioExpanderInvalidate();
     return bOK;
 }
 
+// Forget the cached registers (e.g. after the chip was reset externally)
+void gpioExpanderInvalidate()
+{
+    regCacheValid = 0;
+    olatPending = false;
+}
+
+// Reload every cached register from the chip
+void gpioExpanderResync()
+{
+    uint32_t reg;
+    gpioExpanderInvalidate();
+    for (reg = IODIR; reg <= OLAT; reg += 0x100)
+        if (CACHED_REGS & (1 << (reg >> 8)))
+            readRegisterOrZero(reg);
+}
+
+// Output writes between Begin and the matching Commit are merged in the
+// cached OLAT and sent as one SPI write, so the pins change together.
+// Calls may nest; only the outermost Commit writes.
+void gpioExpanderBegin()
+{
+    batchDepth++;
+}
+
+void gpioExpanderCommit()
+{
+    if (batchDepth == 0) return;
+    if (--batchDepth > 0 || !olatPending) return;
+    olatPending = false;
+    writeRegister(OLAT, regCache[OLAT >> 8]);
+}
+
 void setPinDir(uint8_t pin, bool input)
 {
     if (pin >= 8) return;
-    uint32_t data = 0;
-    sendData(READ | IODIR | BLANK);
-    readData(&data);                           // Read Current Value
-    if (input)
-        data |= (1 << pin);
-    else
-        data &= ~(1 << pin);
-    sendData(WRITE | IODIR | (data & 0xFF)); // Set New Value
-    readData(&data);
+    updateRegisterBit(IODIR, pin, input);
 }
 
 bool getPinDir(uint8_t pin)
 {
-    if (pin >= 8) return;
-    uint32_t data = 0;
-    sendData(READ | IODIR | BLANK);
-    readData(&data); // Read Current Value
-    return (data >> pin) & 0x1;
+    if (pin >= 8) return false;
+    return (readRegisterOrZero(IODIR) >> pin) & 0x1;
 }
 
 void setPinPullup(uint8_t pin, bool value)
 {
     if (pin >= 8) return;
-    uint32_t data = 0;
-    sendData(READ | GPPU | BLANK);
-    readData(&data); // Read Current Value
-    if (value) 
-        data |= (1 << pin);
-    else
-        data &= ~(1 << pin);
-    sendData(WRITE | GPPU | (data & 0xFF)); // Set New Value
-    readData(&data);
+    updateRegisterBit(GPPU, pin, value);
 }
 
 bool getPinPullup(uint8_t pin)
 {
-    if (pin >= 8) return;
-    uint32_t data = 0;
-    sendData(READ | GPPU | BLANK);
-    readData(&data); // Read Current Value
-    return (data >> pin) & 0x1;
+    if (pin >= 8) return false;
+    return (readRegisterOrZero(GPPU) >> pin) & 0x1;
 }
 
+// Outputs are driven through OLAT (a write to GPIO writes OLAT) so the
+// current output state comes from the cache
 void setPinValue(uint8_t pin, bool value)
 {
     if (pin >= 8) return;
-    uint32_t data = 0;
-    sendData(READ | GPIO | BLANK);
-    readData(&data);                        // Read Current Value
-    if (value) 
-        data |= (1 << pin);
-    else
-        data &= ~(1 << pin);
-    sendData(WRITE | GPIO | (data & 0xFF)); // Set New Value
-    readData(&data);
+    updateRegisterBit(OLAT, pin, value);
 }
 
 bool getPinValue(uint8_t pin)
 {
-    if (pin >= 8) return;
-    uint32_t data = 0;
-    sendData(READ | GPIO | BLANK);
-    readData(&data);                        // Read Current Value
-    return ((data >> pin) & 0x1);
+    if (pin >= 8) return false;
+    return (readRegisterOrZero(GPIO) >> pin) & 0x1;
+}
+
+//-----------------------------------------------------------------------------
+// Port-wide calls, each at most one SPI transaction (the cached register
+// provides the bits outside mask)
+//-----------------------------------------------------------------------------
+
+void setPortDir(uint8_t mask, uint8_t value)
+{
+    updateRegister(IODIR, mask, value);
+}
+
+uint8_t getPortDir()
+{
+    return readRegisterOrZero(IODIR);
+}
+
+void setPortPullup(uint8_t mask, uint8_t value)
+{
+    updateRegister(GPPU, mask, value);
+}
+
+uint8_t getPortPullup()
+{
+    return readRegisterOrZero(GPPU);
+}
+
+void writePort(uint8_t mask, uint8_t value)
+{
+    updateRegister(OLAT, mask, value);
+}
+
+uint8_t readPort()
+{
+    return readRegisterOrZero(GPIO);
+}
+
+//-----------------------------------------------------------------------------
+// Whole register file in one transaction
+//-----------------------------------------------------------------------------
+
+bool gpioExpanderSnapshot(struct mcp23s08_regs *regs)
+{
+    uint8_t *data = (uint8_t *)regs;
+    if (!registerBurst(READ, IODIR, REG_COUNT, NULL, data)) return false;
+    cacheRegisters(data);
+    return true;
+}
+
+// INTF and INTCAP are read-only and ignored by the chip; a saved SEQOP is
+// applied after the burst so the address still increments during it
+bool gpioExpanderRestore(const struct mcp23s08_regs *regs)
+{
+    uint8_t data[REG_COUNT];
+    uint8_t i;
+    for (i = 0; i < REG_COUNT; i++)
+        data[i] = ((const uint8_t *)regs)[i];
+    data[IOCON >> 8] &= ~IOCON_SEQOP;
+    data[GPIO >> 8] = regs->olat;
+    if (!registerBurst(WRITE, IODIR, REG_COUNT, data, NULL)) return false;
+    olatPending = false;
+    cacheRegisters(data);
+    if (regs->iocon & IOCON_SEQOP)
+        return writeRegister(IOCON, regs->iocon);
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Interrupt-driven input
+//-----------------------------------------------------------------------------
+
+// Without /dev/gpio_irq (gpio_isr not loaded, or the virtual build) the
+// port is read every POLL_INTERVAL_MS instead, sleeping in between
+static uint8_t pollForChange(uint8_t mask, int timeout, uint8_t *capture)
+{
+    uint8_t start, value;
+    int elapsed = 0;
+    if (!readRegister(GPIO, &start)) return 0;
+    while (timeout < 0 || elapsed < timeout)
+    {
+        usleep(POLL_INTERVAL_MS * 1000);
+        elapsed += POLL_INTERVAL_MS;
+        if (readRegister(GPIO, &value) && ((value ^ start) & mask))
+        {
+            if (capture) *capture = value;
+            return (value ^ start) & mask;
+        }
+    }
+    return 0;
+}
+
+static void closeIrqFile()
+{
+    close(irqFile);
+    irqFile = -1;
+}
+
+// Sleeps until a pin in mask changes or timeout (ms, -1 waits forever)
+// expires, using the MCP23S08 INT output on a GPIO IP pin (IRQ80) through
+// /dev/gpio_irq, then reads INTF and INTCAP in one burst (which re-arms INT)
+// Returns the pins that changed (0 on timeout) and, if capture is not NULL,
+// the port value captured at the interrupt
+// If /dev/gpio_irq cannot be opened or fails, it falls back to
+// pollForChange(), except when arming GPIO_1[31] fails with EBUSY:
+// gpio_expander_driver has claimed the pin and owns the chips, so -1 is
+// returned without touching them, on this and every later call; callers
+// must stop rather than poll the port themselves
+int gpioExpanderWaitForChange(uint8_t mask, int timeout, uint8_t *capture)
+{
+    uint8_t flags[2];
+    uint32_t irqFlags, pinMask = 1u << INT_GPIO_PIN;
+    struct pollfd pfd;
+
+    if (driverLoaded) return -1;
+    if (irqFile < 0)
+    {
+        irqFile = open("/dev/gpio_irq", O_RDWR);
+        if (irqFile < 0)
+            return pollForChange(mask, timeout, capture);
+        if (write(irqFile, &pinMask, sizeof(pinMask)) != sizeof(pinMask))
+        {
+            driverLoaded = (errno == EBUSY);
+            closeIrqFile();
+            return driverLoaded ? -1 : pollForChange(mask, timeout, capture);
+        }
+    }
+
+    // Active low push-pull INT, interrupt on change from the previous value
+    if (!updateRegister(IOCON, IOCON_ODR | IOCON_INTPOL, 0) ||
+        !updateRegister(INTCON, mask, 0) ||
+        !updateRegister(GPINTEN, 0xFF, mask))
+        return 0;
+
+    // Clear anything already latched, since INT only falls once until read
+    if (!registerBurst(READ, INTF, 2, NULL, flags)) return 0;
+    if (!(flags[0] & mask))
+    {
+        pfd.fd = irqFile;
+        pfd.events = POLLIN;
+        if (poll(&pfd, 1, timeout) <= 0) return 0;
+        if (read(irqFile, &irqFlags, sizeof(irqFlags)) != sizeof(irqFlags))
+        {
+            closeIrqFile();
+            return pollForChange(mask, timeout, capture);
+        }
+        if (!registerBurst(READ, INTF, 2, NULL, flags)) return 0;
+    }
+    if (capture) *capture = flags[1];
+    return flags[0] & mask;
 }
@@ -31,11 +31,37 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+//=============================================================================
+// Register File
+//=============================================================================
+
+// All registers in address order, as read or written by one sequential burst
+struct mcp23s08_regs
+{
+    uint8_t iodir;
+    uint8_t ipol;
+    uint8_t gpinten;
+    uint8_t defval;
+    uint8_t intcon;
+    uint8_t iocon;
+    uint8_t gppu;
+    uint8_t intf;
+    uint8_t intcap;
+    uint8_t gpio;
+    uint8_t olat;
+};
+
 //=============================================================================
 // Subroutines
 //=============================================================================
 
 bool gpioExpanderOpen(void);
+void gpioExpanderInvalidate(void);
+void gpioExpanderResync(void);
+bool gpioExpanderSnapshot(struct mcp23s08_regs *regs);
+bool gpioExpanderRestore(const struct mcp23s08_regs *regs);
+void gpioExpanderBegin(void);
+void gpioExpanderCommit(void);
 void setPinDir(uint8_t pin, bool input);
 bool getPinDir(uint8_t pin);
 void setPinPullup(uint8_t pin, bool value);
@@ -43,4 +69,14 @@ bool getPinPullup(uint8_t pin);
 void setPinValue(uint8_t pin, bool value);
 bool getPinValue(uint8_t pin);
 
+void setPortDir(uint8_t mask, uint8_t value);
+uint8_t getPortDir(void);
+void setPortPullup(uint8_t mask, uint8_t value);
+uint8_t getPortPullup(void);
+void writePort(uint8_t mask, uint8_t value);
+uint8_t readPort(void);
+
+// Pins that changed, 0 on timeout, -1 while gpio_expander_driver owns the chips
+int gpioExpanderWaitForChange(uint8_t mask, int timeout, uint8_t *capture);
+
 #endif
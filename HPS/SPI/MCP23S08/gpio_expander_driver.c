@@ -16,20 +16,53 @@
 //   Mapped to offset of 0 in light-weight MM interface aperature
 //   IRQ80 is used as the interrupt interface to the HPS
 
+// Expander interrupt:
+//   MCP23S08 INT (active low) is wired to GPIO_1[31], which raises IRQ80
+
+// Up to 4 expanders share each of the 4 chip selects using hardware
+// addressing (IOCON.HAEN, A1:A0), selected with the chips parameter. Each one
+// is registered as an 8 line gpio_chip ("mcp23s08-<cs>.<addr>") with an
+// irq_chip for edge events, so libgpiod and gpiolib consumers can use them
+// alongside the sysfs attributes under /sys/kernel/spi_expander
+
+// With poll_us set, input reads are served from a snapshot refreshed in the
+// background instead of one SPI frame per read
+
+// The expanders sit on the core spi_driver owns, so spi_driver.ko must be
+// loaded first; every run of expander frames holds its bus lock, which keeps
+// /dev/spi_ip, spi_controller messages and DMA from interleaving words with
+// them in the FIFOs
+
+// GPIO_1[31] is claimed from gpio_isr.ko (also loaded first), so it cannot be
+// armed through /dev/gpio_irq while this driver is loaded. The userspace
+// library (gpio_expander.c) drives the same chips over /dev/mem behind the
+// register cache, so it must not be used alongside this driver.
+
 // Load kernel module with insmod qe_driver.ko [param=___]
 
 //=============================================================================
 
 #include <linux/kernel.h>           // kstrtouint
+#include <linux/string.h>           // skip_spaces
+#include <linux/ctype.h>            // isspace
 #include <linux/module.h>           // MODULE_ macros
 #include <linux/init.h>             // __init
 #include <linux/kobject.h>          // kobject, kobject_atribute,
                                     // kobject_create_and_add, kobject_put
 #include <linux/delay.h>            // delay
+#include <linux/mutex.h>            // mutex
+#include <linux/interrupt.h>        // request_threaded_irq
+#include <linux/irq.h>              // irq_chip, handle_nested_irq
+#include <linux/gpio/driver.h>      // gpio_chip
+#include <linux/kthread.h>          // kthread_run, kthread_stop
+#include <linux/seqlock.h>          // seqlock
+#include <linux/ktime.h>            // ktime_get
 #include <asm/io.h>                 // iowrite, ioread, ioremap_nocache (platform specific)
 #include "../../address_map.h"      // overall memory map
 #include "gpio_expander_regs.h"     // register offsets
 #include "../spi_regs.h"            // register offsets
+#include "../spi_driver.h"          // spiBusLock, spiBusUnlock
+#include "../../GPIO/gpio_isr.h"    // gpioIrqClaim, gpioIrqRelease
 
 //=============================================================================
 // Kernel module information
@@ -46,12 +79,84 @@ MODULE_DESCRIPTION("Gpio Expander Driver");
 #define SYSTEM_CLOCK 50000000
 #define BAUD_RATE 5000000
 #define WORD_SIZE 24
-#define DEVICE 0
 #define MODE_SPO false
 #define MODE_SPH false
 #define CS_AUTO true
 
+#define MAX_CHIPS 16                // 4 hardware addresses on each of the 4 chip selects
+#define CHIP_CS(n) ((n) >> 2)
+#define CHIP_ADDR(n) ((n) & 0x3)
+#define REG_INDEX(reg) ((reg) >> 8)
+#define CACHED_REGS ((1 << REG_INDEX(IODIR)) | (1 << REG_INDEX(IPOL)) | (1 << REG_INDEX(GPINTEN)) \
+                     | (1 << REG_INDEX(DEFVAL)) | (1 << REG_INDEX(INTCON)) | (1 << REG_INDEX(IOCON)) \
+                     | (1 << REG_INDEX(GPPU)) | (1 << REG_INDEX(OLAT)))
+#define RX_EMPTY (1 << 2)
+#define FIFO_RESET ((1 << 6) | (1 << 7))
+#define TRANSACTION_TIMEOUT_US 100
+
+// GPIO IP registers used for the INT line (gpio_regs.h names clash with spi_regs.h)
+#define GPIO_OFS_INT_ENABLE       3
+#define GPIO_OFS_INT_POSITIVE     4
+#define GPIO_OFS_INT_NEGATIVE     5
+#define GPIO_OFS_INT_EDGE_MODE    6
+#define GPIO_OFS_INT_STATUS_CLEAR 7
+#define GPIO_SPAN_IN_BYTES        32
+#define GPIO_IRQ                  80
+#define INT_GPIO_MASK             (1 << 31)
+
+// One MCP23S08, addressed by chip select and A1:A0
+struct expander
+{
+    uint cs;
+    uint addr;
+    uint8_t regs[REG_COUNT];        // register cache, indexed by address
+    uint16_t regsValid;
+    struct gpio_chip chip;
+    struct irq_chip irqchip;
+    char label[16];
+    bool registered;
+    uint irqEnabled;
+    uint irqRising;
+    uint irqFalling;
+    uint irqPrevious;
+};
+
+// One register update in an updatePorts() burst
+struct port_update
+{
+    struct expander *chip;
+    uint reg;
+    uint mask;
+    uint value;
+};
+
+static uint chips = 0x1;
+module_param(chips, uint, S_IRUGO);
+MODULE_PARM_DESC(chips, " Bitmask of expanders present (bit = CS * 4 + A1:A0)");
+
 static unsigned int *base = NULL;
+static unsigned int *gpioBase = NULL;
+static DEFINE_MUTEX(expander_lock);
+static struct expander expanders[MAX_CHIPS];
+static struct expander *primary = NULL;
+static uint csUsed = 0;
+static uint fifoDepth = 1;
+static bool configured = false;
+static uint32_t controlFields = 0;
+static uint32_t controlGeneration = 0;
+static uint32_t brdGeneration = 0;
+
+// Input poller (see Poll Engine)
+static uint poll_us = 0;
+module_param(poll_us, uint, S_IRUGO);
+MODULE_PARM_DESC(poll_us, " Input poll period in us (0 = read on demand)");
+
+static DEFINE_MUTEX(poll_lock);
+static DEFINE_SEQLOCK(snapshot_lock);
+static struct task_struct *pollTask = NULL;
+static uint8_t snapshotGpio[MAX_CHIPS];
+static uint8_t snapshotIntf[MAX_CHIPS];
+static ktime_t snapshotTime;
 
 //=============================================================================
 // Subroutines
@@ -139,7 +244,7 @@ bool getModeForDevice(uint dev, bool *spo, bool *sph)
     uint32_t control_reg = ioread32(base + OFS_CONTROL);
     if (dev > 3) return false;
     *spo = (control_reg >> (17 + (dev * 2))) & 0x1;
-    *sph = (control_reg >> (16 + (dev * 2))) & 0x1;
+    *sph = *spo ^ ((control_reg >> (16 + (dev * 2))) & 0x1);
     iowrite32(control_reg, base + OFS_CONTROL);
     return true;
 }
@@ -149,16 +254,10 @@ bool setModeForDevice(uint dev, bool spo, bool sph)
     bool newSPO, newSPH;
     uint32_t control_reg = ioread32(base + OFS_CONTROL);
     if (dev > 3) return false;
-    if (spo) {
-        control_reg |= (1 << (17 + (dev * 2)));
-    } else {
-        control_reg &= ~(1 << (17 + (dev * 2)));
-    }
-    if (sph) {
-        control_reg |= (1 << (16 + (dev * 2)));
-    } else {
-        control_reg &= ~(1 << (16 + (dev * 2)));
-    }
+    // MODEn[1] is the clock polarity and MODEn[0] selects the opposite
+    // sampling edge, so it holds SPO ^ SPH
+    control_reg &= ~(0x3 << (16 + (dev * 2)));
+    control_reg |= (spo << (17 + (dev * 2))) | ((spo ^ sph) << (16 + (dev * 2)));
     iowrite32(control_reg, base + OFS_CONTROL);
     getModeForDevice(dev, &newSPO, &newSPH);
     return spo == newSPO && sph == newSPH;
@@ -228,152 +327,1008 @@ bool getTxStatus(bool *empty, bool *full, bool *ovr)
     return true;
 }
 //-----------------------------------------------------------------------------------------------------------------
-bool TXdata(uint32_t data)
-{
-    bool empty, full, ovr;
-    uint32_t data_reg = data;
-    getTxStatus(&empty, &full, &ovr);
-    if (full) return false;
-    iowrite32(data_reg, base + OFS_DATA);
-    udelay(10);
-    return true;
+// Prefixes a word with its chip select, word size and the chip's A1:A0 so
+// words for different expanders can share one FIFO burst
+uint32_t tagWord(struct expander *chip, uint32_t data)
+{
+    return TAG(chip->cs, WORD_SIZE) | ((HW_ADDR(chip->addr) | data) & TAG_DATA_MASK);
+}
+
+// Sends count tagged words back to back, a FIFO's worth at a time, and
+// collects the word clocked back for each. When a word does not come back in
+// time both FIFOs are reset, so a late word cannot shift the replies of the
+// next burst, and -ETIMEDOUT is returned.
+int burst(const uint32_t *tx, uint32_t *rx, uint count)
+{
+    uint sent = 0, received = 0, timeout;
+    while (received < count)
+    {
+        while (sent < count && sent - received < fifoDepth)
+            iowrite32(tx[sent++], base + OFS_TAGGED_DATA);
+        timeout = TRANSACTION_TIMEOUT_US * (sent - received);
+        while (received < sent)
+        {
+            if (ioread32(base + OFS_STATUS) & RX_EMPTY)
+            {
+                if (timeout-- == 0)
+                {
+                    iowrite32(FIFO_RESET, base + OFS_STATUS);
+                    return -ETIMEDOUT;
+                }
+                udelay(1);
+                continue;
+            }
+            rx[received++] = ioread32(base + OFS_DATA);
+        }
+    }
+    return 0;
+}
+
+// Sends one word to an expander and stores the word clocked back
+int transaction(struct expander *chip, uint32_t data, uint32_t *rx)
+{
+    uint32_t tx = tagWord(chip, data);
+    return burst(&tx, rx, 1);
+}
+
+// Holds the expander state and the SPI core for a run of frames
+void lockBus(void)
+{
+    mutex_lock(&expander_lock);
+    spiBusLock();
+}
+
+void unlockBus(void)
+{
+    spiBusUnlock();
+    mutex_unlock(&expander_lock);
 }
 //-----------------------------------------------------------------------------------------------------------------
-bool RXdata(uint32_t *data)
-{
-    bool empty, full, ovr;
-    uint32_t data_reg = 0;
-    getRxStatus(&empty, &full, &ovr);
-    data_reg = ioread32(base + OFS_DATA);
-    if (empty) return false;
-    *data = data_reg;
-    udelay(10);
+// The CONTROL fields and BRD captured after the last configure act as a
+// configuration generation; the core is only reprogrammed once another client
+// has changed one of them. Tagged words carry their own chip select and word
+// size, so only the mode and CS_AUTO of the chip selects in use matter.
+void configureSpi(void)
+{
+    uint cs;
+
+    if (configured
+        && (ioread32(base + OFS_CONTROL) & controlFields) == controlGeneration
+        && ioread32(base + OFS_BRD) == brdGeneration)
+        return;
+
+    setBRD(BAUD_RATE);
+    for (cs = 0; cs < 4; cs++)
+    {
+        if (!(csUsed & (1 << cs)))
+            continue;
+        setModeForDevice(cs, MODE_SPO, MODE_SPH);
+        setCSAutoForDevice(cs, CS_AUTO);
+    }
+    iowrite32(ioread32(base + OFS_CONTROL) & ~PROFILE_ENABLE, base + OFS_CONTROL);
+
+    controlGeneration = ioread32(base + OFS_CONTROL) & controlFields;
+    brdGeneration = ioread32(base + OFS_BRD);
+    configured = true;
+}
+
+//================================================================================================================
+// Register Cache
+//================================================================================================================
+
+// Registers are cached per chip; INTF, INTCAP and GPIO follow the pins and
+// are always read from the chip. The cache assumes this driver is the only
+// one talking to the expanders.
+
+// Returns the register value, or a negative error code when the frame was lost
+int readRegister(struct expander *chip, uint reg)
+{
+    uint i = REG_INDEX(reg);
+    uint32_t value;
+    int result;
+    if (chip->regsValid & (1 << i))
+        return chip->regs[i];
+    result = transaction(chip, READ | reg | BLANK, &value);
+    if (result < 0)
+        return result;
+    value &= 0xFF;
+    if (CACHED_REGS & (1 << i))
+    {
+        chip->regs[i] = value;
+        chip->regsValid |= 1 << i;
+    }
+    return value;
+}
+
+// A lost write may or may not have reached the chip, so its cache entry is
+// dropped and read back next time
+int writeRegister(struct expander *chip, uint reg, uint value)
+{
+    uint i = REG_INDEX(reg);
+    uint32_t rx;
+    int result;
+    value &= 0xFF;
+    if ((chip->regsValid & (1 << i)) && chip->regs[i] == value)
+        return 0;
+    result = transaction(chip, WRITE | reg | value, &rx);
+    if (result < 0)
+    {
+        chip->regsValid &= ~(1 << i);
+        return result;
+    }
+    if (CACHED_REGS & (1 << i))
+    {
+        chip->regs[i] = value;
+        chip->regsValid |= 1 << i;
+    }
+    return 0;
+}
+
+// Replaces the bits of reg selected by mask; kept bits come from the cache
+int updateRegister(struct expander *chip, uint reg, uint mask, uint value)
+{
+    int data = 0;
+    mask &= 0xFF;
+    if (mask != 0xFF)
+    {
+        data = readRegister(chip, reg);
+        if (data < 0)
+            return data;
+    }
+    return writeRegister(chip, reg, (data & ~mask) | (value & mask));
+}
+
+//================================================================================================================
+// Edge Events
+//================================================================================================================
+
+// Reading INTCAP or GPIO releases INT, so whichever of the IRQ thread and the
+// poller reads them first hands the flagged changes of a chip to gpiolib
+
+// Picks the flagged lines whose new level matches their trigger type and
+// moves irqPrevious on (caller holds the bus lock)
+uint chipEdges(struct expander *chip, uint flags, uint capture)
+{
+    uint fired = ((capture & ~chip->irqPrevious & chip->irqRising)
+                 | (~capture & chip->irqPrevious & chip->irqFalling)) & flags & chip->irqEnabled;
+    chip->irqPrevious = (chip->irqPrevious & ~flags) | (capture & flags);
+    return fired;
+}
+
+// Runs the nested handlers of the fired lines (without the bus lock)
+void runEdges(struct expander *chip, uint fired)
+{
+    uint pin;
+    for (pin = 0; pin < 8; pin++)
+        if (fired & (1 << pin))
+            handle_nested_irq(irq_find_mapping(chip->chip.irq.domain, pin));
+}
+
+//================================================================================================================
+// Poll Engine
+//================================================================================================================
+
+// With poll_us set, a kernel thread reads INTF, INTCAP and GPIO of every
+// chip in one burst each period into a seqlock protected snapshot. GPIO
+// reads are then served from memory in constant time, so the bus load stays
+// fixed however many readers there are. INTF and INTCAP come first because
+// reading them after GPIO would find the interrupt already cleared; the
+// flagged changes go to gpiolib as from the IRQ thread, and an armed line
+// whose GPIO level moved on after INTCAP was read is reported against that
+// level. A kthread is used rather than an hrtimer because the SPI access
+// sleeps on the bus lock. A lost burst leaves the last snapshot in place.
+
+static int pollThread(void *data)
+{
+    uint32_t tx[3 * MAX_CHIPS], rx[3 * MAX_CHIPS];
+    struct expander *list[MAX_CHIPS];
+    uint fired[MAX_CHIPS];
+    uint i, n = 0, period, flags, capture, gpio;
+    int result;
+
+    for (i = 0; i < MAX_CHIPS; i++)
+    {
+        if (!(chips & (1 << i)))
+            continue;
+        list[n] = &expanders[i];
+        tx[3 * n] = tagWord(list[n], READ | INTF | BLANK);
+        tx[3 * n + 1] = tagWord(list[n], READ | INTCAP | BLANK);
+        tx[3 * n + 2] = tagWord(list[n], READ | GPIO | BLANK);
+        n++;
+    }
+
+    while (!kthread_should_stop())
+    {
+        lockBus();
+        configureSpi();
+        result = burst(tx, rx, 3 * n);
+        for (i = 0; i < n && result == 0; i++)
+        {
+            flags = rx[3 * i] & 0xFF;
+            capture = rx[3 * i + 1] & 0xFF;
+            gpio = rx[3 * i + 2] & 0xFF;
+            fired[i] = chipEdges(list[i], flags, capture);
+            fired[i] |= chipEdges(list[i], (gpio ^ list[i]->irqPrevious) & list[i]->irqEnabled, gpio);
+        }
+        unlockBus();
+
+        if (result == 0)
+        {
+            for (i = 0; i < n; i++)
+                runEdges(list[i], fired[i]);
+
+            write_seqlock(&snapshot_lock);
+            for (i = 0; i < n; i++)
+            {
+                snapshotIntf[list[i] - expanders] = rx[3 * i] & 0xFF;
+                snapshotGpio[list[i] - expanders] = rx[3 * i + 2] & 0xFF;
+            }
+            snapshotTime = ktime_get();
+            write_sequnlock(&snapshot_lock);
+        }
+
+        period = READ_ONCE(poll_us);
+        usleep_range(period, period + period / 8);
+    }
+    return 0;
+}
+
+// Returns the polled GPIO value of a chip and its age in us, or false when
+// the poller is not running
+bool readSnapshot(struct expander *chip, uint *value, s64 *age)
+{
+    unsigned int seq;
+    ktime_t time;
+
+    if (READ_ONCE(pollTask) == NULL)
+        return false;
+    do
+    {
+        seq = read_seqbegin(&snapshot_lock);
+        *value = snapshotGpio[chip - expanders];
+        time = snapshotTime;
+    } while (read_seqretry(&snapshot_lock, seq));
+    if (time == 0)
+        return false;
+    *age = ktime_us_delta(ktime_get(), time);
     return true;
 }
 
+// Stops any running poller and starts a new one when period is not 0
+int setPollPeriod(uint period)
+{
+    int result = 0;
+
+    mutex_lock(&poll_lock);
+    if (pollTask != NULL)
+    {
+        kthread_stop(pollTask);
+        WRITE_ONCE(pollTask, NULL);
+    }
+    poll_us = period;
+    snapshotTime = 0;
+    if (period != 0)
+    {
+        struct task_struct *task = kthread_run(pollThread, NULL, "spi_expander_poll");
+        if (IS_ERR(task))
+        {
+            result = PTR_ERR(task);
+            poll_us = 0;
+        }
+        else
+            WRITE_ONCE(pollTask, task);
+    }
+    mutex_unlock(&poll_lock);
+    return result;
+}
+
+//================================================================================================================
+// Port Access
 //================================================================================================================
 
-void setPinDir(uint pin, bool input)
+// Port accesses return 0 (or the value read) on success and a negative
+// error code when a frame was lost
+
+int updatePort(struct expander *chip, uint reg, uint mask, uint value)
 {
-    uint data = 0;
-    if (pin >= 8) return;
+    int result;
+    lockBus();
+    configureSpi();
+    result = updateRegister(chip, reg, mask, value);
+    unlockBus();
+    return result;
+}
 
-    setBRD(BAUD_RATE);
-    setWordSize(WORD_SIZE);
-    setDevice(DEVICE);
-    setModeForDevice(DEVICE, MODE_SPO, MODE_SPH);
-    setCSAutoForDevice(DEVICE, CS_AUTO);
-
-    TXdata(READ | IODIR | BLANK);
-    RXdata(&data);                           // Read Current Value
-    if(input)
-        data |= (1 << pin);
-    else
-        data &= ~(1 << pin);
-    TXdata(WRITE | IODIR | (data & 0xFF));    // Set New Value
-    RXdata(&data);
+int readPort(struct expander *chip, uint reg)
+{
+    uint value;
+    s64 age;
+    int result;
+    if (reg == GPIO && readSnapshot(chip, &value, &age))
+        return value;
+    lockBus();
+    configureSpi();
+    result = readRegister(chip, reg);
+    unlockBus();
+    return result;
+}
+
+// Applies up to MAX_CHIPS updates to several expanders as one back-to-back
+// burst; updates that leave a register unchanged are dropped. If the burst
+// is lost, the cache entries of every update are dropped.
+int updatePorts(const struct port_update *updates, uint count)
+{
+    uint32_t tx[MAX_CHIPS], rx[MAX_CHIPS];
+    uint i, n = 0, value, index;
+    struct expander *chip;
+    int result = 0;
+
+    if (count > MAX_CHIPS)
+        return -EINVAL;
+    lockBus();
+    configureSpi();
+    for (i = 0; i < count; i++)
+    {
+        chip = updates[i].chip;
+        index = REG_INDEX(updates[i].reg);
+        value = updates[i].value & updates[i].mask & 0xFF;
+        if ((updates[i].mask & 0xFF) != 0xFF)
+        {
+            result = readRegister(chip, updates[i].reg);
+            if (result < 0)
+                break;
+            value |= result & ~updates[i].mask & 0xFF;
+        }
+        if ((chip->regsValid & (1 << index)) && chip->regs[index] == value)
+            continue;
+        tx[n++] = tagWord(chip, WRITE | updates[i].reg | value);
+        if (CACHED_REGS & (1 << index))
+        {
+            chip->regs[index] = value;
+            chip->regsValid |= 1 << index;
+        }
+    }
+    if (result >= 0)
+        result = burst(tx, rx, n);
+    if (result < 0)
+        for (i = 0; i < count; i++)
+            updates[i].chip->regsValid &= ~(1 << REG_INDEX(updates[i].reg));
+    unlockBus();
+    return result < 0 ? result : 0;
 }
 
-void getPinDir(uint pin, bool *state)
+// Reads reg from every chip in the list as one back-to-back burst
+int readPorts(struct expander **chips, uint reg, uint *values, uint count)
 {
-    uint data = 0;
-    if (pin >= 8) return;
+    uint32_t tx[MAX_CHIPS], rx[MAX_CHIPS];
+    uint i;
+    int result;
 
-    setBRD(BAUD_RATE);
-    setWordSize(WORD_SIZE);
-    setDevice(DEVICE);
-    setModeForDevice(DEVICE, MODE_SPO, MODE_SPH);
-    setCSAutoForDevice(DEVICE, CS_AUTO);
+    if (count > MAX_CHIPS)
+        count = MAX_CHIPS;
+    for (i = 0; i < count; i++)
+        tx[i] = tagWord(chips[i], READ | reg | BLANK);
+    lockBus();
+    configureSpi();
+    result = burst(tx, rx, count);
+    unlockBus();
+    if (result < 0)
+        return result;
+    for (i = 0; i < count; i++)
+        values[i] = rx[i] & 0xFF;
+    return 0;
+}
 
-    TXdata(READ | IODIR | BLANK);
-    RXdata(&data);                           // Read Current Value
-    *state = (data >> pin) & 0x1;
+//================================================================================================================
+// First Chip
+//================================================================================================================
+
+// The pin and port attributes under /sys/kernel/spi_expander act on the
+// lowest numbered chip in the chips parameter
+
+int setPortDir(uint mask, uint value)
+{
+    return updatePort(primary, IODIR, mask, value);
+}
+
+// value is left alone when the read fails
+int getPort(uint reg, uint *value)
+{
+    int result = readPort(primary, reg);
+    if (result < 0)
+        return result;
+    *value = result;
+    return 0;
+}
+
+int getPortDir(uint *value)
+{
+    return getPort(IODIR, value);
+}
+
+int setPortPullup(uint mask, uint value)
+{
+    return updatePort(primary, GPPU, mask, value);
+}
+
+int getPortPullup(uint *value)
+{
+    return getPort(GPPU, value);
+}
+
+// Outputs are written through OLAT so the kept bits come from the latch
+// rather than the pin levels
+int setPortData(uint mask, uint value)
+{
+    return updatePort(primary, OLAT, mask, value);
+}
+
+int getPortData(uint *value)
+{
+    return getPort(GPIO, value);
 }
 
 //-----------------------------------------------------------------------------------------------------------------
 
-void setPinPullup(uint pin, bool enable)
+void setPinDir(uint pin, bool input)
 {
-    uint data = 0;
     if (pin >= 8) return;
+    setPortDir(1 << pin, input ? 0xFF : 0);
+}
 
-    setBRD(BAUD_RATE);
-    setWordSize(WORD_SIZE);
-    setDevice(DEVICE);
-    setModeForDevice(DEVICE, MODE_SPO, MODE_SPH);
-    setCSAutoForDevice(DEVICE, CS_AUTO);
-
-    TXdata(READ | GPPU | BLANK);
-    RXdata(&data);                           // Read Current Value
-    if(enable)
-        data |= (1 << pin);
-    else
-        data &= ~(1 << pin);
-    TXdata(WRITE | GPPU | (data & 0xFF));    // Set New Value
-    RXdata(&data);
+void getPinDir(uint pin, bool *state)
+{
+    uint value;
+    if (pin >= 8) return;
+    if (getPortDir(&value) == 0)
+        *state = (value >> pin) & 0x1;
+}
+
+void setPinPullup(uint pin, bool enable)
+{
+    if (pin >= 8) return;
+    setPortPullup(1 << pin, enable ? 0xFF : 0);
 }
 
 void getPinPullup(uint pin, bool *state)
 {
-    uint data = 0;
+    uint value;
     if (pin >= 8) return;
+    if (getPortPullup(&value) == 0)
+        *state = (value >> pin) & 0x1;
+}
 
-    setBRD(BAUD_RATE);
-    setWordSize(WORD_SIZE);
-    setDevice(DEVICE);
-    setModeForDevice(DEVICE, MODE_SPO, MODE_SPH);
-    setCSAutoForDevice(DEVICE, CS_AUTO);
+void setPinData(uint pin, bool value)
+{
+    if (pin >= 8) return;
+    setPortData(1 << pin, value ? 0xFF : 0);
+}
+
+void getPinData(uint pin, bool *state)
+{
+    uint value;
+    if (pin >= 8) return;
+    if (getPortData(&value) == 0)
+        *state = (value >> pin) & 0x1;
+}
+
+//=============================================================================
+// GPIO Chip
+//=============================================================================
+
+// IODIR uses the gpiolib convention (1 = input)
+static int expanderGetDirection(struct gpio_chip *gc, unsigned int offset)
+{
+    int value = readPort(gpiochip_get_data(gc), IODIR);
+    return value < 0 ? value : (value >> offset) & 0x1;
+}
+
+static int expanderDirectionInput(struct gpio_chip *gc, unsigned int offset)
+{
+    return updatePort(gpiochip_get_data(gc), IODIR, 1 << offset, 0xFF);
+}
+
+// Latch the level before turning the driver on so the pin does not glitch
+static int expanderDirectionOutput(struct gpio_chip *gc, unsigned int offset, int value)
+{
+    struct expander *chip = gpiochip_get_data(gc);
+    int result = updatePort(chip, OLAT, 1 << offset, value ? 0xFF : 0);
+    if (result < 0)
+        return result;
+    return updatePort(chip, IODIR, 1 << offset, 0);
+}
 
-    TXdata(READ | GPPU | BLANK);
-    RXdata(&data);                           // Read Current Value
-    *state = (data >> pin) & 0x1;
+static int expanderGet(struct gpio_chip *gc, unsigned int offset)
+{
+    int value = readPort(gpiochip_get_data(gc), GPIO);
+    return value < 0 ? value : (value >> offset) & 0x1;
 }
 
+static void expanderSet(struct gpio_chip *gc, unsigned int offset, int value)
+{
+    updatePort(gpiochip_get_data(gc), OLAT, 1 << offset, value ? 0xFF : 0);
+}
+
+// All lines come from one GPIO read frame
+static int expanderGetMultiple(struct gpio_chip *gc, unsigned long *mask, unsigned long *bits)
+{
+    int value = readPort(gpiochip_get_data(gc), GPIO);
+    if (value < 0)
+        return value;
+    *bits = (*bits & ~*mask) | (value & *mask);
+    return 0;
+}
+
+// All lines go out in one OLAT write frame
+static void expanderSetMultiple(struct gpio_chip *gc, unsigned long *mask, unsigned long *bits)
+{
+    updatePort(gpiochip_get_data(gc), OLAT, *mask, *bits);
+}
+
+static const struct gpio_chip expander_chip =
+{
+    .owner = THIS_MODULE,
+    .base = -1,
+    .ngpio = 8,
+    .can_sleep = true,
+    .get_direction = expanderGetDirection,
+    .direction_input = expanderDirectionInput,
+    .direction_output = expanderDirectionOutput,
+    .get = expanderGet,
+    .set = expanderSet,
+    .get_multiple = expanderGetMultiple,
+    .set_multiple = expanderSetMultiple,
+};
+
+//-----------------------------------------------------------------------------------------------------------------
+// IRQ Chip
 //-----------------------------------------------------------------------------------------------------------------
 
-void setPinData(uint pin, bool value)
+// Each expander interrupts on any change (INTCON = 0); the edge a line asked
+// for is picked out of INTCAP in the IRQ thread
+
+static struct expander *irqExpander(struct irq_data *d)
 {
-    uint data = 0;
-    if (pin >= 8) return;
+    return gpiochip_get_data(irq_data_get_irq_chip_data(d));
+}
 
-    setBRD(BAUD_RATE);
-    setWordSize(WORD_SIZE);
-    setDevice(DEVICE);
-    setModeForDevice(DEVICE, MODE_SPO, MODE_SPH);
-    setCSAutoForDevice(DEVICE, CS_AUTO);
-
-    TXdata(READ | GPIO | BLANK);
-    RXdata(&data);                           // Read Current Value
-    printk(KERN_INFO "Current Data: 0x%08X\n", data);
-    if(value)
-        data |= (1 << pin);
+static void expanderIrqMask(struct irq_data *d)
+{
+    irqExpander(d)->irqEnabled &= ~(1 << irqd_to_hwirq(d));
+}
+
+static void expanderIrqUnmask(struct irq_data *d)
+{
+    irqExpander(d)->irqEnabled |= 1 << irqd_to_hwirq(d);
+}
+
+static int expanderIrqSetType(struct irq_data *d, unsigned int type)
+{
+    struct expander *chip = irqExpander(d);
+    uint pin = 1 << irqd_to_hwirq(d);
+    if (type & IRQ_TYPE_LEVEL_MASK)
+        return -EINVAL;
+    chip->irqRising = (type & IRQ_TYPE_EDGE_RISING) ? (chip->irqRising | pin) : (chip->irqRising & ~pin);
+    chip->irqFalling = (type & IRQ_TYPE_EDGE_FALLING) ? (chip->irqFalling | pin) : (chip->irqFalling & ~pin);
+    return 0;
+}
+
+// mask/unmask/set_type only touch the shadows above; the SPI writes happen
+// once per batch when the bus lock is released
+static void expanderIrqBusLock(struct irq_data *d)
+{
+    lockBus();
+}
+
+// Reading GPIO releases INT and drops the latched INTF/INTCAP, so the edges
+// pending on lines that were already armed are read and dispatched first;
+// GPIO then only seeds irqPrevious of the newly enabled lines
+static void expanderIrqBusSyncUnlock(struct irq_data *d)
+{
+    struct expander *chip = irqExpander(d);
+    uint32_t tx[3], rx[3];
+    uint armed, enabled, fired = 0;
+    int value;
+
+    configureSpi();
+    value = readRegister(chip, GPINTEN);
+    armed = value < 0 ? 0 : value;
+    tx[0] = tagWord(chip, READ | INTF | BLANK);
+    tx[1] = tagWord(chip, READ | INTCAP | BLANK);
+    tx[2] = tagWord(chip, READ | GPIO | BLANK);
+    if (burst(tx, rx, 3) == 0)
+    {
+        fired = chipEdges(chip, rx[0] & armed & 0xFF, rx[1] & 0xFF);
+        enabled = chip->irqEnabled & ~armed;
+        chip->irqPrevious = (chip->irqPrevious & ~enabled) | (rx[2] & enabled);
+    }
+    writeRegister(chip, INTCON, 0x00);
+    writeRegister(chip, GPINTEN, chip->irqEnabled);
+    unlockBus();
+
+    runEdges(chip, fired);
+}
+
+static const struct irq_chip expander_irqchip =
+{
+    .name = "mcp23s08",
+    .irq_mask = expanderIrqMask,
+    .irq_unmask = expanderIrqUnmask,
+    .irq_set_type = expanderIrqSetType,
+    .irq_bus_lock = expanderIrqBusLock,
+    .irq_bus_sync_unlock = expanderIrqBusSyncUnlock,
+    .flags = IRQCHIP_SKIP_SET_WAKE,
+};
+
+// IRQ80 is shared with gpio_isr, from which GPIO_1[31] is claimed
+static irqreturn_t expanderIsr(int irq, void *dev_id)
+{
+    if (!(ioread32(gpioBase + GPIO_OFS_INT_STATUS_CLEAR) & INT_GPIO_MASK))
+        return IRQ_NONE;
+    iowrite32(INT_GPIO_MASK, gpioBase + GPIO_OFS_INT_STATUS_CLEAR);
+    return IRQ_WAKE_THREAD;
+}
+
+// INTF and INTCAP of every armed chip are read in one burst (reading INTCAP
+// releases INT); each flagged line whose new level matches its trigger type
+// gets its nested handler run. The interrupt is ours once the ISR has seen
+// GPIO_1[31], even when the poller got to INTF first or the burst is lost.
+static irqreturn_t expanderIrqThread(int irq, void *dev_id)
+{
+    struct expander *armed[MAX_CHIPS];
+    uint32_t tx[2 * MAX_CHIPS], rx[2 * MAX_CHIPS];
+    uint fired[MAX_CHIPS];
+    uint count = 0, i;
+
+    lockBus();
+    configureSpi();
+    for (i = 0; i < MAX_CHIPS; i++)
+    {
+        if (!(chips & (1 << i)) || expanders[i].irqEnabled == 0)
+            continue;
+        armed[count] = &expanders[i];
+        tx[2 * count] = tagWord(&expanders[i], READ | INTF | BLANK);
+        tx[2 * count + 1] = tagWord(&expanders[i], READ | INTCAP | BLANK);
+        count++;
+    }
+    if (burst(tx, rx, 2 * count) < 0)
+        count = 0;
+    for (i = 0; i < count; i++)
+        fired[i] = chipEdges(armed[i], rx[2 * i] & 0xFF, rx[2 * i + 1] & 0xFF);
+    unlockBus();
+
+    for (i = 0; i < count; i++)
+        runEdges(armed[i], fired[i]);
+    return IRQ_HANDLED;
+}
+
+// Falling edge on GPIO_1[31] for the active low INT output
+static void armIntPin(bool enable)
+{
+    if (enable)
+    {
+        iowrite32(ioread32(gpioBase + GPIO_OFS_INT_EDGE_MODE) | INT_GPIO_MASK, gpioBase + GPIO_OFS_INT_EDGE_MODE);
+        iowrite32(ioread32(gpioBase + GPIO_OFS_INT_NEGATIVE) | INT_GPIO_MASK, gpioBase + GPIO_OFS_INT_NEGATIVE);
+        iowrite32(ioread32(gpioBase + GPIO_OFS_INT_POSITIVE) & ~INT_GPIO_MASK, gpioBase + GPIO_OFS_INT_POSITIVE);
+        iowrite32(INT_GPIO_MASK, gpioBase + GPIO_OFS_INT_STATUS_CLEAR);
+        iowrite32(ioread32(gpioBase + GPIO_OFS_INT_ENABLE) | INT_GPIO_MASK, gpioBase + GPIO_OFS_INT_ENABLE);
+    }
     else
-        data &= ~(1 << pin);
-    printk(KERN_INFO "Current Data: 0x%08X\n", data);
-    TXdata(WRITE | GPIO | (data & 0xFF));    // Set New Value
-    RXdata(&data);
+        iowrite32(ioread32(gpioBase + GPIO_OFS_INT_ENABLE) & ~INT_GPIO_MASK, gpioBase + GPIO_OFS_INT_ENABLE);
 }
 
-void getPinData(uint pin, bool *state)
+//-----------------------------------------------------------------------------------------------------------------
+// Chip Setup
+//-----------------------------------------------------------------------------------------------------------------
+
+// Fills in a context for every chip in the chips parameter and writes IOCON.
+// While HAEN is clear every expander on a chip select answers address 0, so
+// one write there turns on hardware addressing for all of them. With more
+// than one chip the INT outputs are wire-ORed onto GPIO_1[31], so they are
+// switched to open drain, pulled up by the FPGA pin's weak pull-up
+// (WEAK_PULL_UP_RESISTOR in soc_system.qsf). A single chip keeps its
+// push-pull INT.
+static int initExpanders(void)
+{
+    struct expander *chip;
+    uint i, cs, csAddressed = 0, count = 0, iocon;
+    uint32_t rx;
+    int result = 0;
+
+    chips &= (1 << MAX_CHIPS) - 1;
+    fifoDepth = 1 << ((ioread32(base + OFS_FIFO_LEVEL) >> 12) & 0xF);
+    controlFields = PROFILE_ENABLE;
+    for (i = 0; i < MAX_CHIPS; i++)
+    {
+        if (!(chips & (1 << i)))
+            continue;
+        chip = &expanders[i];
+        chip->cs = CHIP_CS(i);
+        chip->addr = CHIP_ADDR(i);
+        csUsed |= 1 << chip->cs;
+        if (chip->addr != 0)
+            csAddressed |= 1 << chip->cs;
+        controlFields |= (1 << (5 + chip->cs)) | (0x3 << (16 + chip->cs * 2));
+        if (primary == NULL)
+            primary = chip;
+        count++;
+    }
+    if (primary == NULL)
+        return -EINVAL;
+
+    lockBus();
+    configureSpi();
+    for (cs = 0; cs < 4 && result == 0; cs++)
+    {
+        struct expander broadcast = { .cs = cs, .addr = 0 };
+        if (csAddressed & (1 << cs))
+            result = transaction(&broadcast, WRITE | IOCON | IOCON_HAEN, &rx);
+    }
+    for (i = 0; i < MAX_CHIPS && result == 0; i++)
+    {
+        if (!(chips & (1 << i)))
+            continue;
+        chip = &expanders[i];
+        iocon = (count > 1) ? IOCON_ODR : 0;
+        if (csAddressed & (1 << chip->cs))
+            iocon |= IOCON_HAEN;
+        result = writeRegister(chip, IOCON, iocon);
+    }
+    unlockBus();
+    return result;
+}
+
+// Registers a gpio_chip with a nested irq_chip per expander behind IRQ80
+static int registerGpioChips(void)
 {
-    uint data = 0;
-    if (pin >= 8) return;
+    struct expander *chip;
+    int i, result;
 
-    setBRD(BAUD_RATE);
-    setWordSize(WORD_SIZE);
-    setDevice(DEVICE);
-    setModeForDevice(DEVICE, MODE_SPO, MODE_SPH);
-    setCSAutoForDevice(DEVICE, CS_AUTO);
+    gpioBase = (unsigned int*)ioremap_nocache(LW_BRIDGE_BASE + GPIO_BASE_OFFSET, GPIO_SPAN_IN_BYTES);
+    if (gpioBase == NULL)
+        return -ENODEV;
+
+    // Fails while a /dev/gpio_irq user has GPIO_1[31] armed
+    result = gpioIrqClaim(INT_GPIO_MASK);
+    if (result != 0)
+    {
+        iounmap(gpioBase);
+        return result;
+    }
+
+    for (i = 0; i < MAX_CHIPS; i++)
+    {
+        if (!(chips & (1 << i)))
+            continue;
+        chip = &expanders[i];
+        snprintf(chip->label, sizeof(chip->label), "mcp23s08-%u.%u", chip->cs, chip->addr);
+        chip->chip = expander_chip;
+        chip->chip.label = chip->label;
+        chip->irqchip = expander_irqchip;
+
+        result = gpiochip_add_data(&chip->chip, chip);
+        if (result != 0)
+            goto err_remove;
+        chip->registered = true;
+
+        result = gpiochip_irqchip_add_nested(&chip->chip, &chip->irqchip, 0, handle_simple_irq, IRQ_TYPE_NONE);
+        if (result != 0)
+            goto err_remove;
+        gpiochip_set_nested_irqchip(&chip->chip, &chip->irqchip, GPIO_IRQ);
+    }
 
-    TXdata(READ | GPIO | BLANK);
-    RXdata(&data);                           // Read Current Value
-    *state = (data >> pin) & 0x1;
+    result = request_threaded_irq(GPIO_IRQ, expanderIsr, expanderIrqThread, IRQF_SHARED, "SPI Expander", expanders);
+    if (result != 0)
+        goto err_remove;
+
+    armIntPin(true);
+    return 0;
+
+err_remove:
+    for (i = 0; i < MAX_CHIPS; i++)
+    {
+        if (expanders[i].registered)
+            gpiochip_remove(&expanders[i].chip);
+        expanders[i].registered = false;
+    }
+    gpioIrqRelease(INT_GPIO_MASK);
+    iounmap(gpioBase);
+    return result;
+}
+
+static void unregisterGpioChips(void)
+{
+    int i;
+    armIntPin(false);
+    free_irq(GPIO_IRQ, expanders);
+    for (i = 0; i < MAX_CHIPS; i++)
+        if (expanders[i].registered)
+            gpiochip_remove(&expanders[i].chip);
+    gpioIrqRelease(INT_GPIO_MASK);
+    iounmap(gpioBase);
 }
 
 //=============================================================================
 // Kernel Objects
 //=============================================================================
 
+// Port attributes take "value" for all 8 pins or "mask value" for some pins
+
+// Port Dir (1 = input)
+static ssize_t port_dirStore(struct kobject *kobj, struct kobj_attribute *attr, const char *buffer, size_t count)
+{
+    uint mask, value;
+    int result = 0, fields = sscanf(buffer, "%i %i", &mask, &value);
+    if (fields == 1)
+        result = setPortDir(0xFF, mask);
+    else if (fields == 2)
+        result = setPortDir(mask, value);
+    return result < 0 ? result : count;
+}
+
+static ssize_t port_dirShow(struct kobject *kobj, struct kobj_attribute *attr, char *buffer)
+{
+    uint value;
+    int result = getPortDir(&value);
+    if (result < 0)
+        return result;
+    return sprintf(buffer, "0x%02X\n", value);
+}
+
+static struct kobj_attribute port_dirAttr = __ATTR(port_dir, 0664, port_dirShow, port_dirStore);
+//-----------------------------------------------------------------------------------------------------------------
+// Port PullUp (1 = enabled)
+static ssize_t port_pullupStore(struct kobject *kobj, struct kobj_attribute *attr, const char *buffer, size_t count)
+{
+    uint mask, value;
+    int result = 0, fields = sscanf(buffer, "%i %i", &mask, &value);
+    if (fields == 1)
+        result = setPortPullup(0xFF, mask);
+    else if (fields == 2)
+        result = setPortPullup(mask, value);
+    return result < 0 ? result : count;
+}
+
+static ssize_t port_pullupShow(struct kobject *kobj, struct kobj_attribute *attr, char *buffer)
+{
+    uint value;
+    int result = getPortPullup(&value);
+    if (result < 0)
+        return result;
+    return sprintf(buffer, "0x%02X\n", value);
+}
+
+static struct kobj_attribute port_pullupAttr = __ATTR(port_pullup, 0664, port_pullupShow, port_pullupStore);
+//-----------------------------------------------------------------------------------------------------------------
+// Port Data (1 = on)
+static ssize_t port_dataStore(struct kobject *kobj, struct kobj_attribute *attr, const char *buffer, size_t count)
+{
+    uint mask, value;
+    int result = 0, fields = sscanf(buffer, "%i %i", &mask, &value);
+    if (fields == 1)
+        result = setPortData(0xFF, mask);
+    else if (fields == 2)
+        result = setPortData(mask, value);
+    return result < 0 ? result : count;
+}
+
+static ssize_t port_dataShow(struct kobject *kobj, struct kobj_attribute *attr, char *buffer)
+{
+    uint value;
+    int result = getPortData(&value);
+    if (result < 0)
+        return result;
+    return sprintf(buffer, "0x%02X\n", value);
+}
+
+static struct kobj_attribute port_dataAttr = __ATTR(port_data, 0664, port_dataShow, port_dataStore);
+//-----------------------------------------------------------------------------------------------------------------
+// Ports of all chips
+// Store takes "chip:value" or "chip:mask:value" entries (chip = CS * 4 + A1:A0)
+// and writes them to OLAT in one burst; a malformed entry, an unknown chip or
+// more than MAX_CHIPS entries reject the whole write. Show reads every chip
+// in one burst
+static ssize_t portsStore(struct kobject *kobj, struct kobj_attribute *attr, const char *buffer, size_t count)
+{
+    struct port_update updates[MAX_CHIPS];
+    uint n = 0, chip, mask, value;
+    int fields, used, result;
+
+    while (*(buffer = skip_spaces(buffer)) != '\0')
+    {
+        if (n == MAX_CHIPS)
+            return -EINVAL;
+        used = 0;
+        fields = sscanf(buffer, "%u:%i:%i%n", &chip, &mask, &value, &used);
+        if (fields == 2)
+        {
+            fields = sscanf(buffer, "%u:%i%n", &chip, &value, &used);
+            mask = 0xFF;
+        }
+        if (fields < 2 || used == 0 || chip >= MAX_CHIPS || !(chips & (1 << chip)))
+            return -EINVAL;
+        if (buffer[used] != '\0' && !isspace(buffer[used]))
+            return -EINVAL;
+        updates[n].chip = &expanders[chip];
+        updates[n].reg = OLAT;
+        updates[n].mask = mask;
+        updates[n].value = value;
+        n++;
+        buffer += used;
+    }
+    if (n == 0)
+        return -EINVAL;
+    result = updatePorts(updates, n);
+    return result < 0 ? result : count;
+}
+
+static ssize_t portsShow(struct kobject *kobj, struct kobj_attribute *attr, char *buffer)
+{
+    struct expander *list[MAX_CHIPS];
+    uint values[MAX_CHIPS];
+    uint i, n = 0;
+    ssize_t length = 0;
+    int result;
+
+    for (i = 0; i < MAX_CHIPS; i++)
+        if (chips & (1 << i))
+            list[n++] = &expanders[i];
+    result = readPorts(list, GPIO, values, n);
+    if (result < 0)
+        return result;
+    for (i = 0; i < n; i++)
+        length += sprintf(buffer + length, "%u:0x%02X\n", list[i]->cs * 4 + list[i]->addr, values[i]);
+    return length;
+}
+
+static struct kobj_attribute portsAttr = __ATTR(ports, 0664, portsShow, portsStore);
+//-----------------------------------------------------------------------------------------------------------------
+// Poll period in us (0 = read on demand)
+static ssize_t poll_usStore(struct kobject *kobj, struct kobj_attribute *attr, const char *buffer, size_t count)
+{
+    uint period;
+    int result = kstrtouint(buffer, 0, &period);
+    if (result == 0)
+        result = setPollPeriod(period);
+    return result == 0 ? count : result;
+}
+
+static ssize_t poll_usShow(struct kobject *kobj, struct kobj_attribute *attr, char *buffer)
+{
+    return sprintf(buffer, "%u\n", poll_us);
+}
+
+static struct kobj_attribute poll_usAttr = __ATTR(poll_us, 0664, poll_usShow, poll_usStore);
+//-----------------------------------------------------------------------------------------------------------------
+// Last poll of every chip as "chip:gpio:intf", then the snapshot age in us
+static ssize_t snapshotShow(struct kobject *kobj, struct kobj_attribute *attr, char *buffer)
+{
+    uint8_t gpio[MAX_CHIPS], intf[MAX_CHIPS];
+    unsigned int seq;
+    ktime_t time;
+    ssize_t length = 0;
+    uint i;
+
+    do
+    {
+        seq = read_seqbegin(&snapshot_lock);
+        memcpy(gpio, snapshotGpio, sizeof(gpio));
+        memcpy(intf, snapshotIntf, sizeof(intf));
+        time = snapshotTime;
+    } while (read_seqretry(&snapshot_lock, seq));
+    if (time == 0)
+        return sprintf(buffer, "stopped\n");
+    for (i = 0; i < MAX_CHIPS; i++)
+        if (chips & (1 << i))
+            length += sprintf(buffer + length, "%u:0x%02X:0x%02X\n", i, gpio[i], intf[i]);
+    length += sprintf(buffer + length, "age_us %lld\n", ktime_us_delta(ktime_get(), time));
+    return length;
+}
+
+static struct kobj_attribute snapshotAttr = __ATTR(snapshot, 0444, snapshotShow, NULL);
+
+//================================================================================================================
+
 // PIN0
 // Dir 0
 static bool dir0 = 0;
@@ -1124,71 +2079,113 @@ static int __init initialize_module(void)
 {
     int result;
 
+    printk(KERN_INFO "SPI Expander driver: starting\n");
 
+    // Physical to virtual memory map to access spi registers
+    base = (unsigned int*)ioremap_nocache(LW_BRIDGE_BASE + SPI_BASE_OFFSET, SPAN_IN_BYTES);
+    if (base == NULL)
+        return -ENODEV;
 
-    printk(KERN_INFO "SPI Expander driver: starting\n");
+    result = initExpanders();
+    if (result != 0)
+        goto err_unmap;
+
+    result = registerGpioChips();
+    if (result != 0)
+        goto err_unmap;
 
-    // Create qe directory under /sys/kernel
+    // Create spi_expander directory under /sys/kernel; the attributes act on
+    // primary and the SPI core, so they come last
     kobj = kobject_create_and_add("spi_expander", kernel_kobj);
     if (!kobj)
     {
         printk(KERN_ALERT "SPI Expaander driver: failed to create and add kobj\n");
-        return -ENOENT;
+        result = -ENOENT;
+        goto err_chips;
     }
 
     // Create pin0-7 groups
     result = sysfs_create_group(kobj, &group0);
     if (result !=0)
-        return result;
+        goto err_kobj;
 
     result = sysfs_create_group(kobj, &group1);
     if (result !=0)
-        return result;
+        goto err_kobj;
 
     result = sysfs_create_group(kobj, &group2);
     if (result !=0)
-        return result;
+        goto err_kobj;
 
     result = sysfs_create_group(kobj, &group3);
     if (result !=0)
-        return result;
+        goto err_kobj;
 
     result = sysfs_create_group(kobj, &group4);
     if (result !=0)
-        return result;
+        goto err_kobj;
 
     result = sysfs_create_group(kobj, &group5);
     if (result !=0)
-        return result;
+        goto err_kobj;
 
     result = sysfs_create_group(kobj, &group6);
     if (result !=0)
-        return result;
+        goto err_kobj;
 
     result = sysfs_create_group(kobj, &group7);
     if (result !=0)
-        return result;
+        goto err_kobj;
 
-        // Physical to virtual memory map to access gpio registers
-    base = (unsigned int*)ioremap_nocache(LW_BRIDGE_BASE + SPI_BASE_OFFSET, SPAN_IN_BYTES);
-    if (base == NULL)
-        return -ENODEV;
+    // Create port-wide attributes
+    result = sysfs_create_file(kobj, &port_dirAttr.attr);
+    if (result !=0)
+        goto err_kobj;
 
-    setBRD(BAUD_RATE);
-    setWordSize(WORD_SIZE);
-    setDevice(DEVICE);
-    setModeForDevice(DEVICE, MODE_SPO, MODE_SPH);
-    setCSAutoForDevice(DEVICE, CS_AUTO);
+    result = sysfs_create_file(kobj, &port_pullupAttr.attr);
+    if (result !=0)
+        goto err_kobj;
+
+    result = sysfs_create_file(kobj, &port_dataAttr.attr);
+    if (result !=0)
+        goto err_kobj;
+
+    result = sysfs_create_file(kobj, &portsAttr.attr);
+    if (result !=0)
+        goto err_kobj;
+
+    result = sysfs_create_file(kobj, &poll_usAttr.attr);
+    if (result !=0)
+        goto err_kobj;
+
+    result = sysfs_create_file(kobj, &snapshotAttr.attr);
+    if (result !=0)
+        goto err_kobj;
+
+    result = setPollPeriod(poll_us);
+    if (result != 0)
+        goto err_kobj;
 
     printk(KERN_INFO "SPI Expander driver: initialized\n");
 
     return 0;
+
+err_kobj:
+    kobject_put(kobj);
+err_chips:
+    unregisterGpioChips();
+err_unmap:
+    iounmap(base);
+    return result;
 }
 
 
 static void __exit exit_module(void)
 {
+    setPollPeriod(0);
     kobject_put(kobj);
+    unregisterGpioChips();
+    iounmap(base);
     printk(KERN_INFO "SPI Expander driver: exit\n");
 }
 
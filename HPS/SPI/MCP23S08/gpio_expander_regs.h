@@ -23,6 +23,7 @@
 
 #define READ                 0x410000
 #define WRITE                0x400000
+#define HW_ADDR(addr)        (((addr) & 0x3) << 17)  // A1:A0 in the opcode, needs IOCON_HAEN
 
 #define IODIR                0x000000
 #define IPOL                 0x000100
@@ -38,5 +39,11 @@
 
 #define BLANK                0x0000FF
 
+#define REG_COUNT            11          // IODIR..OLAT
+#define IOCON_SEQOP          0x20        // 1 disables sequential addressing
+#define IOCON_HAEN           0x08        // A1:A0 select among chips sharing a chip select
+#define IOCON_ODR            0x04        // INT is open drain
+#define IOCON_INTPOL         0x02        // INT is active high
+
 #endif
 
@@ -26,6 +26,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include "gpio_expander.h"
 
 // Pins
@@ -38,26 +39,46 @@
 #define GREEN_LED 6
 #define BLUE_LED 7
 
+#define BUTTONS ((1 << BUTTON_0) | (1 << BUTTON_1) | (1 << BUTTON_2))
+#define LEDS ((1 << RED_LED) | (1 << ORANGE_LED) | (1 << YELLOW_LED) | (1 << GREEN_LED) | (1 << BLUE_LED))
+
 //=============================================================================
 // Subroutines
 //=============================================================================
 
+// The kernel driver owns the expander, so waiting here would mean polling
+// it behind the driver's back
+void exitDriverLoaded()
+{
+	printf("gpio_expander_driver is loaded; unload it to use this program\n");
+	exit(EXIT_FAILURE);
+}
+
 // Blocking function that returns only when BUTTON_0 is pressed
+// Sleeps on the expander interrupt between checks instead of polling
 void waitPb0Press()
 {
-	while(getPinValue(BUTTON_0));
+	while(getPinValue(BUTTON_0))
+		if (gpioExpanderWaitForChange(1 << BUTTON_0, -1, NULL) < 0)
+			exitDriverLoaded();
 }
 
 // Blocking function that returns only when BUTTON_1 is pressed
+// Sleeps on the expander interrupt between checks instead of polling
 void waitPb1Press()
 {
-	while(getPinValue(BUTTON_1));
+	while(getPinValue(BUTTON_1))
+		if (gpioExpanderWaitForChange(1 << BUTTON_1, -1, NULL) < 0)
+			exitDriverLoaded();
 }
 
 // Blocking function that returns only when BUTTON_2 is pressed
+// Sleeps on the expander interrupt between checks instead of polling
 void waitPb2Press()
 {
-	while(getPinValue(BUTTON_2));
+	while(getPinValue(BUTTON_2))
+		if (gpioExpanderWaitForChange(1 << BUTTON_2, -1, NULL) < 0)
+			exitDriverLoaded();
 }
 
 // Initialize Hardware
@@ -67,27 +88,9 @@ void initHw()
     gpioExpanderOpen();
 
     // Configure LED and pushbutton pins
-    setPinDir(BUTTON_0, DIR_INPUT);
-    setPinPullup(BUTTON_0, PULLUP_ENABLE);
-
-    setPinDir(RED_LED, DIR_OUTPUT);
-    setPinDir(ORANGE_LED, DIR_OUTPUT);
-    setPinDir(YELLOW_LED, DIR_OUTPUT);
-
-    setPinDir(BUTTON_1, DIR_INPUT);
-    setPinPullup(BUTTON_1, PULLUP_ENABLE);
-
-    setPinDir(BUTTON_2, DIR_INPUT);
-    setPinPullup(BUTTON_2, PULLUP_ENABLE);
-
-    setPinDir(GREEN_LED, DIR_OUTPUT);
-    setPinDir(BLUE_LED, DIR_OUTPUT);
-
-    setPinValue(RED_LED, OFF);
-    setPinValue(ORANGE_LED, OFF);
-    setPinValue(YELLOW_LED, OFF);
-    setPinValue(GREEN_LED, OFF);
-    setPinValue(BLUE_LED, OFF);
+    setPortDir(0xFF, BUTTONS);
+    setPortPullup(0xFF, BUTTONS);
+    writePort(LEDS, 0);
 }
 
 //=============================================================================
@@ -100,61 +103,37 @@ int main(void)
 	initHw();
 
     while (true) {
-        setPinValue(RED_LED, OFF);
-        setPinValue(ORANGE_LED, OFF);
-        setPinValue(YELLOW_LED, OFF);
-        setPinValue(GREEN_LED, OFF);
-        setPinValue(BLUE_LED, OFF);
+        writePort(LEDS, 0);
 
         // Wait for PB0 press
         waitPb0Press();
 
         // Turn on red LED and all others off.
-        setPinValue(RED_LED, ON);
-        setPinValue(ORANGE_LED, OFF);
-        setPinValue(YELLOW_LED, OFF);
-        setPinValue(GREEN_LED, OFF);
-        setPinValue(BLUE_LED, OFF);
+        writePort(LEDS, (1 << RED_LED));
 
         // Wait for PB1 press
         waitPb1Press();
 
         // Turn on orange LED and all others off.
-        setPinValue(RED_LED, OFF);
-        setPinValue(ORANGE_LED, ON);
-        setPinValue(YELLOW_LED, OFF);
-        setPinValue(GREEN_LED, OFF);
-        setPinValue(BLUE_LED, OFF);
+        writePort(LEDS, (1 << ORANGE_LED));
 
         // Wait for PB2 press
         waitPb2Press();
 
         // Turn on yellow LED and all others off.
-        setPinValue(RED_LED, OFF);
-        setPinValue(ORANGE_LED, OFF);
-        setPinValue(YELLOW_LED, ON);
-        setPinValue(GREEN_LED, OFF);
-        setPinValue(BLUE_LED, OFF);
+        writePort(LEDS, (1 << YELLOW_LED));
 
         // Wait for PB0 press
         waitPb0Press();
 
         // Turn on green LED and all others off.
-        setPinValue(RED_LED, OFF);
-        setPinValue(ORANGE_LED, OFF);
-        setPinValue(YELLOW_LED, OFF);
-        setPinValue(GREEN_LED, ON);
-        setPinValue(BLUE_LED, OFF);
+        writePort(LEDS, (1 << GREEN_LED));
 
         // Wait for PB1 press
         waitPb1Press();
 
         // Turn on blue LED and all others off.
-        setPinValue(RED_LED, OFF);
-        setPinValue(ORANGE_LED, OFF);
-        setPinValue(YELLOW_LED, OFF);
-        setPinValue(GREEN_LED, OFF);
-        setPinValue(BLUE_LED, ON);
+        writePort(LEDS, (1 << BLUE_LED));
 
         // Wait for PB1 press
         waitPb2Press();
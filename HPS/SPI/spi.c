@@ -56,6 +56,7 @@ int main(int argc, char* argv[])
             printf("  \n");
             printf("  spi send [data]                        Send data to Tx FIFO\n");
             printf("  spi read                               Read data from Rx FIFO\n");
+            printf("  spi transfer [data] [data] ...         Send words and read replies\n");
             printf("  \n");
             printf("  spi [rx/tx] status                     Gets status of selected FIFO\n");
             printf("  spi [rx/tx] count                      Gets count of selected FIFO\n");
@@ -64,16 +65,24 @@ int main(int argc, char* argv[])
             printf("  \n");
             printf("  spi wordsize                           Gets current word size in bits\n");
             printf("  spi wordsize set [32-1]                Sets current word size in bits\n");
+            printf("  spi frame                              Gets words sent per chip select\n");
+            printf("  spi frame set [length]                 Sets words sent per chip select\n");
             printf("  \n");
             printf("  spi device                             Gets current selected device\n");
             printf("  spi device set [0-3]                   Sets current selected device\n");
             printf("  \n");
+            printf("  spi [0-3] send [25-1] [data]           Send data tagged for dev\n");
             printf("  spi [0-3] csmode                       Gets current mode for dev\n");
             printf("  spi [0-3] csmode set [auto/manual]     Sets current mode for dev\n");
             printf("  spi [0-3] cs                           Gets current cs state (manual)\n");
             printf("  spi [0-3] cs set [assert/deassert]     Sets current cs state (manual)\n");
             printf("  spi [0-3] mode                         Gets current device mode\n");
             printf("  spi [0-3] mode set [SPO] [SPH]         Sets current device mode\n");
+            printf("  spi [0-3] profile                      Gets device profile\n");
+            printf("  spi [0-3] profile set [size] [SPO] [SPH] [auto/manual] [baud_rate]\n");
+            printf("                                         Sets device profile\n");
+            printf("  spi profile                            Gets per-device profile status\n");
+            printf("  spi profile set [enable/disable]       Sets per-device profile status\n");
             printf("  \n");
             printf("  spi brd                                Gets current baud rate\n");
             printf("  spi brd set [baud_rate]                Sets current baud rate\n");
@@ -120,6 +129,21 @@ int main(int argc, char* argv[])
                 printf("  Error Occured\n");
             }
             valid_command = true;
+        } else if ((strcmp(argv[1], "transfer") == 0) && argc > 2) {
+            size_t n = argc - 2, i;
+            uint32_t *tx = malloc(n * sizeof(uint32_t));
+            uint32_t *rx = malloc(n * sizeof(uint32_t));
+            for (i = 0; i < n; i++)
+                tx[i] = (uint32_t)strtol(argv[i + 2], NULL, 0);
+            if (spiTransfer(tx, rx, n)) {
+                for (i = 0; i < n; i++)
+                    printf("  Sent: 0x%08X  Received: 0x%08X\n", tx[i], rx[i]);
+            } else {
+                printf("  Error Occured\n");
+            }
+            free(tx);
+            free(rx);
+            valid_command = true;
         } else if ((strcmp(argv[1], "rx") == 0 || strcmp(argv[1], "tx") == 0) && argc == 3) {
             if ((strcmp(argv[2], "status") == 0)) {
                 bool empty, full, ovr, success;
@@ -136,7 +160,7 @@ int main(int argc, char* argv[])
                 valid_command = true;
             } else if ((strcmp(argv[2], "count") == 0)) {
                 bool success;
-                uint8_t count;
+                uint16_t count;
                 if ((strcmp(argv[1], "rx") == 0)) {
                     success = getRxCount(&count);
                 } else if ((strcmp(argv[1], "tx") == 0)) {
@@ -194,6 +218,25 @@ int main(int argc, char* argv[])
                 }
                 valid_command = true;
             }
+        } else if ((strcmp(argv[1], "frame") == 0)) {
+            if (argc == 2) {
+                uint16_t length = 0;
+                bool success = getFrameLength(&length);
+                if (success) {
+                    printf("  Frame length: %d\n", length);
+                } else {
+                    printf("  Error Occured\n");
+                }
+                valid_command = true;
+            } else if ((strcmp(argv[2], "set") == 0) && argc == 4) {
+                uint16_t length = (uint16_t)strtol(argv[3], NULL, 0);
+                if (setFrameLength(length)) {
+                    printf("  Set frame length: %d\n", length);
+                } else {
+                    printf("  Error Occured\n");
+                }
+                valid_command = true;
+            }
         } else if ((strcmp(argv[1], "device") == 0)) {
             if (argc == 2) {
                 uint8_t dev = 0;
@@ -216,7 +259,16 @@ int main(int argc, char* argv[])
         } else if ((strcmp(argv[1], "0") == 0) || (strcmp(argv[1], "1") == 0) || (strcmp(argv[1], "2") == 0) || (strcmp(argv[1], "3") == 0)) {
             uint8_t dev = (uint8_t)strtol(argv[1], NULL, 10);
             if (argc > 2) {
-                if ((strcmp(argv[2], "csmode") == 0)) {
+                if ((strcmp(argv[2], "send") == 0) && argc == 5) {
+                    uint8_t size = (uint8_t)strtol(argv[3], NULL, 0);
+                    uint32_t data = (uint32_t)strtol(argv[4], NULL, 0);
+                    if (sendTaggedData(dev, size, data)) {
+                        printf("  Device %d, Sent Data: 0x%08X\n", dev, data);
+                    } else {
+                        printf("  Error Occured\n");
+                    }
+                    valid_command = true;
+                } else if ((strcmp(argv[2], "csmode") == 0)) {
                     if (argc == 3) {
                         bool mode;
                         bool success = getCSModeForDevice(dev, &mode);
@@ -311,7 +363,50 @@ int main(int argc, char* argv[])
                             valid_command = true;
                         }
                     }
+                } else  if ((strcmp(argv[2], "profile") == 0)) {
+                    if (argc == 3) {
+                        uint8_t size;
+                        bool spo, sph, csAuto;
+                        double brd;
+                        if (getProfileForDevice(dev, &size, &spo, &sph, &csAuto, &brd)) {
+                            printf("  Profile: %d bits, Mode %d:%d, CS %s, %lfHz\n", size,
+                                   spo ? 1 : 0, sph ? 1 : 0, csAuto ? "Auto" : "Manual", brd);
+                        } else {
+                            printf("  Error Occured\n");
+                        }
+                        valid_command = true;
+                    } else if ((strcmp(argv[3], "set") == 0) && argc == 9) {
+                        uint8_t size = (uint8_t)strtol(argv[4], NULL, 0);
+                        bool spo = strcmp(argv[5], "1") == 0;
+                        bool sph = strcmp(argv[6], "1") == 0;
+                        bool csAuto = strcmp(argv[7], "auto") == 0;
+                        double brd = strtod(argv[8], NULL);
+                        if (setProfileForDevice(dev, size, spo, sph, csAuto, brd)) {
+                            printf("  Device %d, Profile set\n", dev);
+                        } else {
+                            printf("  Error Occured\n");
+                        }
+                        valid_command = true;
+                    }
+                }
+            }
+        } else if ((strcmp(argv[1], "profile") == 0)) {
+            if (argc == 2) {
+                bool enable;
+                if (getProfileEnable(&enable)) {
+                    printf("  Profiles: %s\n", enable ? "Enabled" : "Disabled");
+                } else {
+                    printf("  Error Occured\n");
+                }
+                valid_command = true;
+            } else if ((strcmp(argv[2], "set") == 0) && argc == 4) {
+                bool enable = strcmp(argv[3], "enable") == 0;
+                if (setProfileEnable(enable)) {
+                    printf("  Profiles: %s\n", enable ? "Enabled" : "Disabled");
+                } else {
+                    printf("  Error Occured\n");
                 }
+                valid_command = true;
             }
         } else if ((strcmp(argv[1], "brd") == 0)) {
             if (argc == 2) {
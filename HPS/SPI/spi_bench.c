@@ -0,0 +1,275 @@
+// SPI IP
+// SPI Benchmark App
+// CSE4356-SoC | Fall 2021 | Term Project
+// Deborah Jahaj and Nathan Fusselman
+
+//=============================================================================
+// Hardware Target
+//=============================================================================
+
+// Target Platform: DE1-SoC Board, or any Linux host when built with
+// SPI_STANDIN against the software register model (make spi_bench_standin)
+
+// Hardware configuration:
+// SPI Port:
+//   GPIO_0[7,9,11,13,15,17,19] are used as a SPI interface
+// HPS interface:
+//   Mapped to offset of 8000 in light-weight MM interface aperature
+
+// Sweeps CS mode, SCLK, word size and burst length, timing spiTransfer()
+// and reporting throughput, latency percentiles and register accesses
+// per word as CSV (default) or JSON
+
+//=============================================================================
+// Device includes, defines, and assembler directives
+//=============================================================================
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "spi_ip.h"
+#ifdef SPI_COSIM
+#include "spi_cosim.h"
+#endif
+
+#if defined(SPI_STANDIN)
+#define BACKEND "standin"
+#elif defined(SPI_COSIM)
+#define BACKEND "cosim"
+#elif defined(VIRTUAL_DE1SOC)
+#define BACKEND "virtual"
+#else
+#define BACKEND "hardware"
+#endif
+
+#define MAX_BURST 256
+
+//=============================================================================
+// Global variables
+//=============================================================================
+
+const double sclkRates[] = {1000000, 5000000, 12500000};
+const uint16_t bursts[] = {1, 4, 16, 64, MAX_BURST};
+const uint8_t quickSizes[] = {1, 8, 16, 25, 32};
+
+uint32_t txBuffer[MAX_BURST];
+uint32_t rxBuffer[MAX_BURST];
+
+struct bench_result
+{
+    bool csAuto;
+    double sclk;
+    uint8_t size;
+    uint16_t burst;
+    uint32_t transfers;
+    uint32_t errors;
+    double wordsPerSec;
+    double bytesPerSec;
+    double p50;
+    double p99;
+    double p999;
+    double mmioPerWord;
+};
+
+//=============================================================================
+// Subroutines
+//=============================================================================
+
+// Simulated time of the RTL under SPI_COSIM, host time otherwise
+static double nowUs()
+{
+#ifdef SPI_COSIM
+    return cosimCycles() * 0.02;
+#endif
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int compareDouble(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of a sorted array
+static double percentile(const double *sorted, uint32_t n, double p)
+{
+    uint32_t rank = (uint32_t)ceil(p * n);
+    if (rank < 1) rank = 1;
+    return sorted[rank - 1];
+}
+
+static bool configurePoint(uint8_t dev, bool csAuto, double sclk, uint8_t size)
+{
+    bool ok = setStatus(false);
+    ok &= setProfileEnable(false);
+    ok &= setDevice(dev);
+    ok &= setWordsize(size);
+    ok &= setCSModeForDevice(dev, csAuto);
+    ok &= setCSEnableForDevice(dev, !csAuto);
+    ok &= setBRD(sclk);
+    ok &= resetTx();
+    ok &= resetRx();
+    clearRxOV();
+    clearTxOV();
+    ok &= setStatus(true);
+    return ok;
+}
+
+static void runPoint(struct bench_result *result, double *latency)
+{
+    uint32_t mask = (result->size == 32) ? 0xFFFFFFFF : ((1u << result->size) - 1);
+    uint32_t i, t;
+    for (i = 0; i < result->burst; i++)
+        txBuffer[i] = (0xA5A5A5A5 ^ (i * 0x01010101)) & mask;
+
+    result->errors = 0;
+    uint64_t mmioStart = spiMmioCount;
+    double start = nowUs();
+    for (t = 0; t < result->transfers; t++)
+    {
+        double before = nowUs();
+        if (!spiTransfer(txBuffer, rxBuffer, result->burst))
+        {
+            result->errors++;
+            clearRxOV();
+            clearTxOV();
+            resetTx();
+            resetRx();
+        }
+        latency[t] = nowUs() - before;
+    }
+    double elapsed = nowUs() - start;
+    uint64_t mmio = spiMmioCount - mmioStart;
+
+    double words = (double)result->transfers * result->burst;
+    qsort(latency, result->transfers, sizeof(double), compareDouble);
+    result->wordsPerSec = words / (elapsed / 1e6);
+    result->bytesPerSec = result->wordsPerSec * result->size / 8;
+    result->p50 = percentile(latency, result->transfers, 0.50);
+    result->p99 = percentile(latency, result->transfers, 0.99);
+    result->p999 = percentile(latency, result->transfers, 0.999);
+    result->mmioPerWord = mmio / words;
+}
+
+static void printResult(const struct bench_result *result, bool json, bool first)
+{
+    if (json)
+    {
+        printf("%s    {\"cs_mode\": \"%s\", \"sclk_hz\": %.0f, \"word_size\": %u, "
+               "\"burst\": %u, \"transfers\": %u, \"errors\": %u, "
+               "\"words_per_s\": %.1f, \"bytes_per_s\": %.1f, "
+               "\"p50_us\": %.2f, \"p99_us\": %.2f, \"p999_us\": %.2f, "
+               "\"mmio_per_word\": %.3f}",
+               first ? "" : ",\n", result->csAuto ? "auto" : "manual", result->sclk,
+               result->size, result->burst, result->transfers, result->errors,
+               result->wordsPerSec, result->bytesPerSec,
+               result->p50, result->p99, result->p999, result->mmioPerWord);
+    }
+    else
+    {
+        printf("%s,%s,%.0f,%u,%u,%u,%u,%.1f,%.1f,%.2f,%.2f,%.2f,%.3f\n",
+               BACKEND, result->csAuto ? "auto" : "manual", result->sclk,
+               result->size, result->burst, result->transfers, result->errors,
+               result->wordsPerSec, result->bytesPerSec,
+               result->p50, result->p99, result->p999, result->mmioPerWord);
+    }
+    fflush(stdout);
+}
+
+//=============================================================================
+// Main
+//=============================================================================
+
+int main(int argc, char* argv[])
+{
+    bool json = false;
+    bool quick = false;
+    uint32_t transfers = 100;
+    uint8_t dev = 0;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) {
+            json = true;
+        } else if (strcmp(argv[i], "--quick") == 0) {
+            quick = true;
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            transfers = (uint32_t)strtol(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            dev = (uint8_t)strtol(argv[++i], NULL, 0);
+        } else {
+            printf("  usage:\n");
+            printf("  spi_bench [--json] [--quick] [-n transfers] [-d device]\n");
+            printf("  \n");
+            printf("  --json          JSON output instead of CSV\n");
+            printf("  --quick         Word sizes 1, 8, 16, 25 and 32 only\n");
+            printf("  -n transfers    Transfers timed per point (default 100)\n");
+            printf("  -d device       Chip select to drive (default 0)\n");
+            return (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (transfers < 1 || dev > 3) {
+        fprintf(stderr, "  Invalid argument\n");
+        return EXIT_FAILURE;
+    }
+    if (!spiOpen()) {
+        fprintf(stderr, "  Could not open SPI IP\n");
+        return EXIT_FAILURE;
+    }
+
+    double *latency = malloc(transfers * sizeof(double));
+    if (latency == NULL) return EXIT_FAILURE;
+
+    // Leave the core as it was found
+    struct spi_config saved;
+    bool savedProfileEnable;
+    spiGetConfig(&saved);
+    getProfileEnable(&savedProfileEnable);
+
+    if (json) {
+        printf("{\n  \"backend\": \"%s\",\n  \"results\": [\n", BACKEND);
+    } else {
+        printf("backend,cs_mode,sclk_hz,word_size,burst,transfers,errors,"
+               "words_per_s,bytes_per_s,p50_us,p99_us,p999_us,mmio_per_word\n");
+    }
+
+    bool first = true;
+    uint8_t sizeCount = quick ? sizeof(quickSizes) : 32;
+    int mode;
+    uint8_t r, s, b;
+    for (mode = 1; mode >= 0; mode--) {
+        for (r = 0; r < sizeof(sclkRates) / sizeof(sclkRates[0]); r++) {
+            for (s = 0; s < sizeCount; s++) {
+                uint8_t size = quick ? quickSizes[s] : s + 1;
+                if (!configurePoint(dev, mode, sclkRates[r], size)) {
+                    fprintf(stderr, "  Could not configure %s %.0f Hz %u bits\n",
+                            mode ? "auto" : "manual", sclkRates[r], size);
+                    continue;
+                }
+                for (b = 0; b < sizeof(bursts) / sizeof(bursts[0]); b++) {
+                    struct bench_result result = {
+                        .csAuto = mode, .sclk = sclkRates[r], .size = size,
+                        .burst = bursts[b], .transfers = transfers
+                    };
+                    runPoint(&result, latency);
+                    printResult(&result, json, first);
+                    first = false;
+                }
+            }
+        }
+    }
+
+    if (json) printf("\n  ]\n}\n");
+
+    setCSEnableForDevice(dev, false);
+    spiConfigure(&saved);
+    setProfileEnable(savedProfileEnable);
+    free(latency);
+    return EXIT_SUCCESS;
+}
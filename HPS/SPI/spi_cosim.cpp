@@ -0,0 +1,215 @@
+// SPI IP
+// SPI IP RTL Co-simulation
+// CSE4356-SoC | Fall 2021 | Term Project
+// Deborah Jahaj and Nathan Fusselman
+
+//=============================================================================
+// Hardware Target
+//=============================================================================
+
+// Target Platform: Any Linux host with Verilator 4.200 or later
+
+// Bus timing follows tb_spi_dev.v: a strobe is held for one clock and
+// dropped for one clock, as the FIFOs act on strobe edges; read data is
+// sampled after the first clock, before the Rx pop takes effect.
+// SPI_COSIM_BUS_WAIT adds that many idle clocks to every access to stand in
+// for the HPS to FPGA bridge latency (0 by default, core timing only).
+// SPI_COSIM_REPORT names a CSV file for the per-call report instead of
+// stderr.
+
+// Per-call timing uses -finstrument-functions on spi_ip.c: entry and exit
+// of every function record the cycle and access counts, and times are
+// inclusive of nested calls.
+
+//=============================================================================
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dlfcn.h>
+#include <map>
+#include <memory>
+#include "verilated.h"
+#include "Vspi_dev.h"
+#include "spi_cosim.h"
+
+#define CLOCK_PERIOD_NS  20   // 50 MHz
+#define RESET_CYCLES     4
+#define MAX_CALL_DEPTH   32
+
+//=============================================================================
+// Global variables
+//=============================================================================
+
+static std::unique_ptr<VerilatedContext> context;
+static std::unique_ptr<Vspi_dev> dut;
+static uint64_t cycles = 0;
+static uint64_t accesses = 0;
+static uint32_t busWait = 0;
+
+struct call_stats
+{
+    uint64_t calls;
+    uint64_t cycles;
+    uint64_t maxCycles;
+    uint64_t accesses;
+};
+
+struct call_frame
+{
+    void *function;
+    uint64_t cycles;
+    uint64_t accesses;
+};
+
+static std::map<void *, call_stats> stats;
+static call_frame callStack[MAX_CALL_DEPTH];
+static int callDepth = 0;
+
+//=============================================================================
+// Subroutines
+//=============================================================================
+
+static void tick()
+{
+    dut->rx = dut->tx;
+    dut->clk = 0;
+    dut->eval();
+    context->timeInc(CLOCK_PERIOD_NS / 2);
+    dut->rx = dut->tx;
+    dut->clk = 1;
+    dut->eval();
+    context->timeInc(CLOCK_PERIOD_NS / 2);
+    cycles++;
+}
+
+static const char *functionName(void *function)
+{
+    Dl_info info;
+    static char buffer[32];
+    if (dladdr(function, &info) && info.dli_sname)
+        return info.dli_sname;
+    snprintf(buffer, sizeof(buffer), "%p", function);
+    return buffer;
+}
+
+static void report()
+{
+    const char *path = getenv("SPI_COSIM_REPORT");
+    FILE *file = path ? fopen(path, "w") : NULL;
+    bool csv = file != NULL;
+    if (!csv) file = stderr;
+
+    if (csv)
+        fprintf(file, "function,calls,total_us,mean_us,max_us,accesses_per_call\n");
+    else
+    {
+        fprintf(file, "\n  spi_dev co-simulation: %llu cycles (%.2f us), %llu accesses\n",
+                (unsigned long long)cycles, cycles * CLOCK_PERIOD_NS / 1e3,
+                (unsigned long long)accesses);
+        fprintf(file, "  %-24s %8s %12s %10s %10s %10s\n",
+                "function", "calls", "total_us", "mean_us", "max_us", "acc/call");
+    }
+    for (const auto &entry : stats)
+    {
+        const call_stats &s = entry.second;
+        double total = s.cycles * CLOCK_PERIOD_NS / 1e3;
+        fprintf(file, csv ? "%s,%llu,%.3f,%.3f,%.3f,%.2f\n"
+                          : "  %-24s %8llu %12.3f %10.3f %10.3f %10.2f\n",
+                functionName(entry.first), (unsigned long long)s.calls, total,
+                total / s.calls, s.maxCycles * CLOCK_PERIOD_NS / 1e3,
+                (double)s.accesses / s.calls);
+    }
+    if (csv) fclose(file);
+}
+
+extern "C" {
+
+void cosimReset()
+{
+    const char *wait = getenv("SPI_COSIM_BUS_WAIT");
+    if (!dut)
+    {
+        context.reset(new VerilatedContext);
+        dut.reset(new Vspi_dev{context.get()});
+        atexit(report);
+    }
+    busWait = wait ? strtoul(wait, NULL, 0) : 0;
+    dut->chipselect = 0;
+    dut->read = 0;
+    dut->write = 0;
+    dut->byteenable = 0xF;
+    dut->dma_readdata = 0;
+    dut->dma_waitrequest = 0;
+    dut->reset = 1;
+    for (int i = 0; i < RESET_CYCLES; i++)
+        tick();
+    dut->reset = 0;
+    tick();
+}
+
+uint32_t cosimRead(uint8_t ofs)
+{
+    uint32_t data;
+    dut->address = ofs;
+    dut->chipselect = 1;
+    dut->read = 1;
+    tick();
+    data = dut->readdata;
+    dut->chipselect = 0;
+    dut->read = 0;
+    tick();
+    for (uint32_t i = 0; i < busWait; i++)
+        tick();
+    accesses++;
+    return data;
+}
+
+void cosimWrite(uint8_t ofs, uint32_t data)
+{
+    dut->address = ofs;
+    dut->writedata = data;
+    dut->chipselect = 1;
+    dut->write = 1;
+    tick();
+    dut->chipselect = 0;
+    dut->write = 0;
+    tick();
+    for (uint32_t i = 0; i < busWait; i++)
+        tick();
+    accesses++;
+}
+
+void cosimDelay(uint32_t us)
+{
+    uint64_t count = (uint64_t)us * 1000 / CLOCK_PERIOD_NS;
+    for (uint64_t i = 0; i < count; i++)
+        tick();
+}
+
+uint64_t cosimCycles()
+{
+    return cycles;
+}
+
+void __cyg_profile_func_enter(void *function, void *caller)
+{
+    if (callDepth < MAX_CALL_DEPTH)
+        callStack[callDepth] = {function, cycles, accesses};
+    callDepth++;
+}
+
+void __cyg_profile_func_exit(void *function, void *caller)
+{
+    if (--callDepth >= MAX_CALL_DEPTH || callDepth < 0) return;
+    const call_frame &frame = callStack[callDepth];
+    call_stats &s = stats[frame.function];
+    uint64_t elapsed = cycles - frame.cycles;
+    s.calls++;
+    s.cycles += elapsed;
+    s.accesses += accesses - frame.accesses;
+    if (elapsed > s.maxCycles) s.maxCycles = elapsed;
+}
+
+}
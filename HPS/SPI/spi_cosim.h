@@ -0,0 +1,43 @@
+// SPI IP
+// SPI IP RTL Co-simulation
+// CSE4356-SoC | Fall 2021 | Term Project
+// Deborah Jahaj and Nathan Fusselman
+
+//=============================================================================
+// Hardware Target
+//=============================================================================
+
+// Target Platform: Any Linux host with Verilator 4.200 or later
+
+// Runs spi_ip.c against a Verilated spi_dev (../../FPGA/spi_dev.v) when it
+// is built with SPI_COSIM (make spi_cosim, make spi_bench_cosim). Each
+// register access is an Avalon transfer clocked at 50 MHz, and MOSI is
+// looped back to MISO. At exit the simulated time of every spi_ip.c call
+// is reported.
+
+//=============================================================================
+
+#ifndef SPI_COSIM_H_
+#define SPI_COSIM_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//=============================================================================
+// Subroutines
+//=============================================================================
+
+void cosimReset();
+uint32_t cosimRead(uint8_t ofs);
+void cosimWrite(uint8_t ofs, uint32_t data);
+void cosimDelay(uint32_t us);
+uint64_t cosimCycles();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -16,6 +16,12 @@
 //   Mapped to offset of 8000 in light-weight MM interface aperature
 
 // Load kernel module with insmod spi_driver.ko [param=___]
+// Binary word streams are read from and written to /dev/spi_ip
+// IRQ81 is used for the FIFO watermark, end of frame and DMA interrupts
+// Other modules submit DMA descriptors with spiDmaSubmit() and hold the
+// core across their own FIFO accesses with spiBusLock()/spiBusUnlock()
+// The core is also registered as an spi_controller, so spidev and upstream
+// SPI drivers can be bound to chip selects 0-3
 
 //=============================================================================
 
@@ -25,9 +31,21 @@
 #include <linux/kobject.h>    // kobject, kobject_atribute,
                               // kobject_create_and_add, kobject_put
 #include <linux/delay.h>      // delay
+#include <linux/fs.h>         // file_operations
+#include <linux/miscdevice.h> // misc_register, misc_deregister
+#include <linux/uaccess.h>    // copy_to_user, copy_from_user
+#include <linux/kfifo.h>      // kfifo
+#include <linux/mutex.h>      // mutex
+#include <linux/jiffies.h>    // msecs_to_jiffies
+#include <linux/interrupt.h>  // request_irq, free_irq
+#include <linux/wait.h>       // wait queues
+#include <linux/dma-mapping.h> // dma_alloc_coherent
+#include <linux/platform_device.h> // platform_driver, platform_device
+#include <linux/spi/spi.h>    // spi_controller, spi_message, spi_transfer
 #include <asm/io.h>           // iowrite, ioread, ioremap_nocache (platform specific)
 #include "../address_map.h"   // overall memory map
 #include "spi_regs.h"         // register offsets in SPI IP
+#include "spi_driver.h"       // kernel interface
 
 //=============================================================================
 // Kernel module information
@@ -42,8 +60,33 @@ MODULE_DESCRIPTION("SPI IP Driver");
 //=============================================================================
 
 #define SYSTEM_CLOCK 50000000
+#define CHUNK_WORDS 256
+#define RX_BUFFER_WORDS 4096
+#define TRANSFER_TIMEOUT_MS 100
+#define SPIN_POLLS 16
+#define DMA_CHUNK_WORDS 4096
+#define DMA_MIN_WORDS 64
+#define DMA_IDLE_TIMEOUT_MS 1000
 
 static unsigned int *base = NULL;
+static uint32_t fifo_depth = 16;
+
+static DEFINE_MUTEX(spi_lock);
+static DEFINE_KFIFO(rx_buffer, uint32_t, RX_BUFFER_WORDS);
+static uint32_t tx_chunk[CHUNK_WORDS];
+static uint32_t rx_chunk[CHUNK_WORDS];
+
+static DECLARE_WAIT_QUEUE_HEAD(spi_wait);
+static bool spi_event = false;
+
+static struct miscdevice spi_miscdev;
+static struct platform_device *spi_pdev = NULL;
+static int spi_irq = -1;
+
+static bool dma_present = false;
+static bool dma_hung = false;
+static uint32_t *dma_tx_buffer = NULL, *dma_rx_buffer = NULL;
+static dma_addr_t dma_tx_handle, dma_rx_handle;
 
 //=============================================================================
 // Subroutines
@@ -106,6 +149,19 @@ bool setWordSize(uint size)
     return true;
 }
 //-----------------------------------------------------------------------------------------------------------------
+bool getFrameLength(uint *length)
+{
+    *length = ioread32(base + OFS_FRAME_LENGTH) & 0xFFFF;
+    return true;
+}
+
+bool setFrameLength(uint length)
+{
+    if (length > 0xFFFF) return false;
+    iowrite32(length, base + OFS_FRAME_LENGTH);
+    return true;
+}
+//-----------------------------------------------------------------------------------------------------------------
 bool getDevice(uint *dev)
 {
     uint32_t control_reg = ioread32(base + OFS_CONTROL);
@@ -130,8 +186,8 @@ bool getModeForDevice(uint dev, bool *spo, bool *sph)
 {
     uint32_t control_reg = ioread32(base + OFS_CONTROL);
     if (dev > 3) return false;
-    *spo = (control_reg >> (16 + (dev * 2))) & 0x1;
-    *sph = (control_reg >> (17 + (dev * 2))) & 0x1;
+    *spo = (control_reg >> (17 + (dev * 2))) & 0x1;
+    *sph = *spo ^ ((control_reg >> (16 + (dev * 2))) & 0x1);
     iowrite32(control_reg, base + OFS_CONTROL);
     return true;
 }
@@ -141,16 +197,10 @@ bool setModeForDevice(uint dev, bool spo, bool sph)
     bool newSPO, newSPH;
     uint32_t control_reg = ioread32(base + OFS_CONTROL);
     if (dev > 3) return false;
-    if (spo) {
-        control_reg |= (1 << (16 + (dev * 2)));
-    } else {
-        control_reg &= ~(1 << (16 + (dev * 2)));
-    }
-    if (sph) {
-        control_reg |= (1 << (17 + (dev * 2)));
-    } else {
-        control_reg &= ~(1 << (17 + (dev * 2)));
-    }
+    // MODEn[1] is the clock polarity and MODEn[0] selects the opposite
+    // sampling edge, so it holds SPO ^ SPH
+    control_reg &= ~(0x3 << (16 + (dev * 2)));
+    control_reg |= (spo << (17 + (dev * 2))) | ((spo ^ sph) << (16 + (dev * 2)));
     iowrite32(control_reg, base + OFS_CONTROL);
     getModeForDevice(dev, &newSPO, &newSPH);
     return spo == newSPO && sph == newSPH;
@@ -224,6 +274,7 @@ bool TXdata(uint32_t data)
 {
     bool empty, full, ovr;
     uint32_t data_reg = data;
+    if (dma_hung) return false;
     getTxStatus(&empty, &full, &ovr);
     if (full) return false;
     iowrite32(data_reg, base + OFS_DATA);
@@ -235,6 +286,7 @@ bool RXdata(uint32_t *data)
 {
     bool empty, full, ovr;
     uint32_t data_reg = 0;
+    if (dma_hung) return false;
     getRxStatus(&empty, &full, &ovr);
     data_reg = ioread32(base + OFS_DATA);
     if (empty) return false;
@@ -242,6 +294,229 @@ bool RXdata(uint32_t *data)
     udelay(1);
     return true;
 }
+//-----------------------------------------------------------------------------------------------------------------
+static irqreturn_t isr(int irq, void *dev_id)
+{
+    uint32_t pending = ioread32(base + OFS_INT_STATUS) & ioread32(base + OFS_INT_ENABLE);
+    if (pending == 0)
+        return IRQ_NONE;
+
+    // Mask all sources (the watermarks are level sensitive) and clear end of frame
+    iowrite32(0, base + OFS_INT_ENABLE);
+    iowrite32(INT_EOF | INT_DMA, base + OFS_INT_STATUS);
+
+    spi_event = true;
+    wake_up_interruptible(&spi_wait);
+    return IRQ_HANDLED;
+}
+
+// Sleep until the Rx FIFO holds rxLevel words, the Tx FIFO drains to half
+// (when txRefill is set) or the last queued word has been shifted out
+int waitForFifo(uint32_t rxLevel, bool txRefill)
+{
+    long remaining;
+
+    spi_event = false;
+    iowrite32(INT_EOF, base + OFS_INT_STATUS);
+    iowrite32((rxLevel << 16) | (fifo_depth / 2), base + OFS_WATERMARK);
+    iowrite32(INT_RX_HIGH | INT_EOF | (txRefill ? INT_TX_LOW : 0), base + OFS_INT_ENABLE);
+    remaining = wait_event_interruptible_timeout(spi_wait, spi_event,
+                                                 msecs_to_jiffies(TRANSFER_TIMEOUT_MS));
+    iowrite32(0, base + OFS_INT_ENABLE);
+    if (remaining < 0)
+        return remaining;
+    if (remaining == 0)
+        return -ETIMEDOUT;
+    return 0;
+}
+//-----------------------------------------------------------------------------------------------------------------
+// Clock cycles per bit on chip select cs: its profile divisor while the
+// profiles are enabled, BRD otherwise (6 fractional bits, rounded up)
+uint32_t bitCycles(uint cs)
+{
+    uint32_t divisor;
+    if (ioread32(base + OFS_CONTROL) & PROFILE_ENABLE)
+        divisor = ioread32(base + OFS_PROFILE + (cs & 0x3)) >> 8;
+    else
+        divisor = ioread32(base + OFS_BRD);
+    return max_t(uint32_t, (divisor + 63) >> 6, 1);
+}
+
+// Drops whatever earlier users left in the core: the Tx FIFO is reset so
+// nothing new starts, the word the serializer may still be shifting (up to
+// 32 bits on the slowest chip select) is waited out, then both FIFOs are
+// reset and the sticky overflow bits cleared
+void flushFifos(void)
+{
+    uint32_t cycles = 0, us;
+    uint cs;
+
+    iowrite32(1 << 7, base + OFS_STATUS);
+    for (cs = 0; cs < 4; cs++)
+        cycles = max_t(uint32_t, cycles, bitCycles(cs));
+    us = DIV_ROUND_UP(32 * cycles, SYSTEM_CLOCK / 1000000);
+    usleep_range(us, us + us / 8 + 1);
+    iowrite32((1 << 7) | (1 << 6) | (1 << 3) | (1 << 0), base + OFS_STATUS);
+}
+
+// Full-duplex transfer of n words, filling the Tx FIFO up to its free space
+// and draining the Rx FIFO into rx as words arrive (rx may be NULL)
+// The FIFOs are flushed first, so words left by sysfs tx_data or an earlier
+// failed transfer are not taken as replies. count is set to the words
+// received, including on an error, after which the FIFOs are flushed again;
+// words sent but not received may have gone out.
+int transferWords(const uint32_t *tx, uint32_t *rx, size_t n, size_t *count)
+{
+    size_t sent = 0, received = 0;
+    uint32_t level_reg, data;
+    uint32_t txCount, rxCount, txFree, rxLevel;
+    uint32_t polls = 0;
+    int result = 0;
+    bool progress;
+
+    *count = 0;
+    if (dma_hung || !(ioread32(base + OFS_CONTROL) & (1 << 15))) return -EIO;
+    flushFifos();
+    while (received < n && result == 0)
+    {
+        level_reg = ioread32(base + OFS_FIFO_LEVEL);
+        txCount = level_reg & 0xFFF;
+        rxCount = (level_reg >> 16) & 0xFFF;
+
+        progress = false;
+        while (rxCount > 0 && received < n)
+        {
+            data = ioread32(base + OFS_DATA);
+            if (rx)
+                rx[received] = data;
+            received++;
+            rxCount--;
+            progress = true;
+        }
+
+        txFree = fifo_depth - txCount;
+        while (txFree > 0 && sent < n && (sent - received) < fifo_depth)
+        {
+            iowrite32(tx[sent], base + OFS_DATA);
+            sent++;
+            txFree--;
+            progress = true;
+        }
+
+        if (progress)
+            polls = 0;
+        else if (ioread32(base + OFS_STATUS) & ((1 << 0) | (1 << 3)))
+            result = -EIO;
+        else if (++polls < SPIN_POLLS)
+            cpu_relax();
+        else
+        {
+            // Nothing to do until the FIFOs move, so sleep on the watermark
+            // and end of frame interrupts instead of polling STATUS
+            rxLevel = min_t(uint32_t, sent - received, fifo_depth / 2);
+            result = waitForFifo(max_t(uint32_t, rxLevel, 1), sent < n);
+            polls = 0;
+        }
+    }
+    if (result != 0)
+        flushFifos();
+    *count = received;
+    return result;
+}
+//-----------------------------------------------------------------------------------------------------------------
+// The DMA engine cannot be aborted and owns the FIFOs while BUSY, so after
+// a missed interrupt it is polled until idle before spi_lock is released; an
+// engine that never finishes leaves the core unusable (dma_hung) instead of
+// letting PIO transfers share the FIFOs with it
+int dmaWaitIdle(void)
+{
+    unsigned long end = jiffies + msecs_to_jiffies(DMA_IDLE_TIMEOUT_MS);
+
+    while (ioread32(base + OFS_DMA_CONTROL) & DMA_BUSY)
+    {
+        if (time_after(jiffies, end))
+        {
+            dma_hung = true;
+            printk(KERN_ALERT "SPI driver: DMA engine stuck busy, core disabled\n");
+            return -ETIMEDOUT;
+        }
+        msleep(1);
+    }
+    return 0;
+}
+
+// Run one DMA descriptor to completion (caller holds spi_lock)
+int dmaRun(const struct spi_dma_descriptor *desc)
+{
+    uint32_t control, cycles;
+    unsigned long timeout;
+    long remaining;
+
+    if (dma_hung)
+        return -EIO;
+    control = DMA_GO | ((desc->cs & 0x3) << 3) | (((desc->word_size - 1) & 0x1F) << 5);
+    if (desc->flags & SPI_DMA_TX)
+        control |= DMA_TX;
+    if (desc->flags & SPI_DMA_RX)
+        control |= DMA_RX;
+
+    // Allow for the words at the baud rate of the chip select (its profile
+    // when the profiles are on) on top of the usual timeout
+    cycles = bitCycles(desc->cs);
+    timeout = msecs_to_jiffies(TRANSFER_TIMEOUT_MS) +
+              msecs_to_jiffies(div_u64((u64)desc->count * desc->word_size * cycles * 1000, SYSTEM_CLOCK) + 1);
+
+    iowrite32(desc->src, base + OFS_DMA_SRC);
+    iowrite32(desc->dst, base + OFS_DMA_DST);
+    iowrite32(desc->count, base + OFS_DMA_COUNT);
+    iowrite32(INT_DMA, base + OFS_INT_STATUS);
+    spi_event = false;
+    iowrite32(INT_DMA, base + OFS_INT_ENABLE);
+    iowrite32(control, base + OFS_DMA_CONTROL);
+
+    // The DMA engine cannot be aborted, so wait for it uninterruptibly
+    remaining = wait_event_timeout(spi_wait, spi_event, timeout);
+    iowrite32(0, base + OFS_INT_ENABLE);
+    if (remaining == 0)
+        return dmaWaitIdle();
+    return 0;
+}
+
+struct device *spiDmaDevice(void)
+{
+    return spi_pdev ? &spi_pdev->dev : NULL;
+}
+EXPORT_SYMBOL(spiDmaDevice);
+
+int spiDmaSubmit(const struct spi_dma_descriptor *desc)
+{
+    int result;
+
+    if (!dma_present)
+        return -ENODEV;
+    if (desc->count == 0 || desc->cs > 3 || desc->word_size < 1 || desc->word_size > 32 ||
+        (desc->flags & ~(SPI_DMA_TX | SPI_DMA_RX)))
+        return -EINVAL;
+    mutex_lock(&spi_lock);
+    result = dmaRun(desc);
+    mutex_unlock(&spi_lock);
+    return result;
+}
+EXPORT_SYMBOL(spiDmaSubmit);
+
+// Keeps /dev/spi_ip, the sysfs data attributes, spi_controller messages and
+// DMA off the core while another module uses the FIFOs directly
+void spiBusLock(void)
+{
+    mutex_lock(&spi_lock);
+}
+EXPORT_SYMBOL(spiBusLock);
+
+void spiBusUnlock(void)
+{
+    mutex_unlock(&spi_lock);
+}
+EXPORT_SYMBOL(spiBusUnlock);
 
 //=============================================================================
 // Kernel Objects Devices0-3
@@ -297,6 +572,33 @@ static struct kobj_attribute word_sizeAttr = __ATTR(word_size, 0664, word_sizeSh
 
 //-----------------------------------------------------------------------------------------------------------------
 
+// Frame Length (words per chip select assertion)
+static unsigned int frame_length = 0;
+module_param(frame_length, uint, S_IRUGO);
+MODULE_PARM_DESC(frame_length, " Frame Length");
+
+static ssize_t frame_lengthStore(struct kobject *kobj, struct kobj_attribute *attr, const char *buffer, size_t count)
+{
+    unsigned int temp;
+    int result = kstrtouint(buffer, 0, &temp);
+    if (result == 0 && temp <= 0xFFFF)
+    {
+        frame_length = temp;
+        setFrameLength(frame_length);
+    }
+    return count;
+}
+
+static ssize_t frame_lengthShow(struct kobject *kobj, struct kobj_attribute *attr, char *buffer)
+{
+    getFrameLength(&frame_length);
+    return sprintf(buffer, "%d\n", frame_length);
+}
+
+static struct kobj_attribute frame_lengthAttr = __ATTR(frame_length, 0664, frame_lengthShow, frame_lengthStore);
+
+//-----------------------------------------------------------------------------------------------------------------
+
 // CS Select
 static unsigned int cs_select = 0;
 module_param(cs_select, uint, S_IRUGO);
@@ -692,7 +994,9 @@ static ssize_t tx_dataStore(struct kobject *kobj, struct kobj_attribute *attr, c
     if (result == 0)
     {
         tx_data = temp;
+        mutex_lock(&spi_lock);
         TXdata(tx_data);
+        mutex_unlock(&spi_lock);
     }
     return count;
 }
@@ -708,7 +1012,10 @@ MODULE_PARM_DESC(rx_data, " RX Data");
 
 static ssize_t rx_dataShow(struct kobject *kobj, struct kobj_attribute *attr, char *buffer)
 {
-    bool result = RXdata(&rx_data);
+    bool result;
+    mutex_lock(&spi_lock);
+    result = RXdata(&rx_data);
+    mutex_unlock(&spi_lock);
     if (!result)
         rx_data = -1;
     return sprintf(buffer, "0x%08X\n", rx_data);
@@ -750,6 +1057,380 @@ static struct attribute_group device3 =
 
 static struct kobject *kobj;
 
+//=============================================================================
+// Character Device
+//=============================================================================
+
+// write() takes a buffer of 32-bit words to clock out on the selected device
+// read() returns the words received during earlier writes
+
+static ssize_t spi_ip_write(struct file *file, const char __user *buffer, size_t count, loff_t *offset)
+{
+    size_t words = count / sizeof(uint32_t);
+    size_t done = 0, n;
+    int result = 0;
+    struct spi_dma_descriptor dma;
+
+    if (count % sizeof(uint32_t) != 0)
+        return -EINVAL;
+    if (mutex_lock_interruptible(&spi_lock))
+        return -ERESTARTSYS;
+
+    // Every word clocked out is kept for read(), so the write is cut short
+    // to the room left in rx_buffer
+    words = min_t(size_t, words, kfifo_avail(&rx_buffer));
+    if (words == 0 && count != 0)
+    {
+        mutex_unlock(&spi_lock);
+        return -ENOSPC;
+    }
+
+    // DMA descriptors keep the currently selected device and word size
+    dma.src = dma_tx_handle;
+    dma.dst = dma_rx_handle;
+    dma.flags = SPI_DMA_TX | SPI_DMA_RX;
+    dma.cs = (ioread32(base + OFS_CONTROL) >> 13) & 0x3;
+    dma.word_size = (ioread32(base + OFS_CONTROL) & 0x1F) + 1;
+    while (done < words && result == 0)
+    {
+        // Long streams go through the DMA engine using the bounce buffers
+        if (dma_present && words - done >= DMA_MIN_WORDS)
+        {
+            n = min_t(size_t, words - done, DMA_CHUNK_WORDS);
+            if (copy_from_user(dma_tx_buffer, buffer + done * sizeof(uint32_t), n * sizeof(uint32_t)))
+            {
+                result = -EFAULT;
+                break;
+            }
+            dma.count = n;
+            result = dmaRun(&dma);
+            if (result == 0)
+            {
+                kfifo_in(&rx_buffer, dma_rx_buffer, n);
+                done += n;
+            }
+            continue;
+        }
+
+        n = min_t(size_t, words - done, CHUNK_WORDS);
+        if (copy_from_user(tx_chunk, buffer + done * sizeof(uint32_t), n * sizeof(uint32_t)))
+        {
+            result = -EFAULT;
+            break;
+        }
+        result = transferWords(tx_chunk, rx_chunk, n, &n);
+        kfifo_in(&rx_buffer, rx_chunk, n);
+        done += n;
+    }
+    mutex_unlock(&spi_lock);
+    if (done == 0 && result != 0)
+        return result;
+    return done * sizeof(uint32_t);
+}
+
+static ssize_t spi_ip_read(struct file *file, char __user *buffer, size_t count, loff_t *offset)
+{
+    unsigned int copied;
+    int result;
+
+    if (count % sizeof(uint32_t) != 0)
+        return -EINVAL;
+    if (mutex_lock_interruptible(&spi_lock))
+        return -ERESTARTSYS;
+    result = kfifo_to_user(&rx_buffer, buffer, count, &copied);
+    mutex_unlock(&spi_lock);
+    return result ? result : copied;
+}
+
+static const struct file_operations spi_fops =
+{
+    .owner = THIS_MODULE,
+    .read = spi_ip_read,
+    .write = spi_ip_write,
+    .llseek = no_llseek,
+};
+
+static struct miscdevice spi_miscdev =
+{
+    .minor = MISC_DYNAMIC_MINOR,
+    .name = "spi_ip",
+    .fops = &spi_fops,
+};
+
+//=============================================================================
+// SPI Controller
+//=============================================================================
+
+// Messages from the kernel SPI core run on the device's chip select with CS
+// held by software (CS auto off) for the whole message, so cs_change and
+// multi-transfer messages behave as the core expects
+
+// Words are 1, 2 or 4 bytes in the transfer buffers depending on bits_per_word
+static uint32_t getBufferWord(const void *buffer, size_t i, uint32_t bytes)
+{
+    if (bytes == 1)
+        return ((const uint8_t *)buffer)[i];
+    if (bytes == 2)
+        return ((const uint16_t *)buffer)[i];
+    return ((const uint32_t *)buffer)[i];
+}
+
+static void setBufferWord(void *buffer, size_t i, uint32_t bytes, uint32_t data)
+{
+    if (bytes == 1)
+        ((uint8_t *)buffer)[i] = data;
+    else if (bytes == 2)
+        ((uint16_t *)buffer)[i] = data;
+    else
+        ((uint32_t *)buffer)[i] = data;
+}
+
+// Select the device and apply its word size, mode and speed in one CONTROL
+// write (caller holds spi_lock and restores PROFILE_ENABLE afterwards)
+// MODEn is {CPOL, CPOL ^ CPHA}, as in setModeForDevice
+static void configureDevice(struct spi_device *spi, struct spi_transfer *xfer)
+{
+    uint32_t cs = spi->chip_select;
+    uint32_t cpol = (spi->mode & SPI_CPOL) ? 1 : 0;
+    uint32_t cpha = (spi->mode & SPI_CPHA) ? 1 : 0;
+    uint32_t control_reg = ioread32(base + OFS_CONTROL);
+    control_reg &= ~(0x1F | (1 << (5 + cs)) | (0x3 << 13) | (0x3 << (16 + (cs * 2))) | PROFILE_ENABLE);
+    control_reg |= ((xfer->bits_per_word - 1) & 0x1F) | (cs << 13);
+    control_reg |= ((cpol << 1) | (cpol ^ cpha)) << (16 + (cs * 2));
+    iowrite32(control_reg, base + OFS_CONTROL);
+    setBRD(xfer->speed_hz);
+}
+
+static void setDeviceCS(struct spi_device *spi, bool assert)
+{
+    uint32_t control_reg = ioread32(base + OFS_CONTROL);
+    control_reg &= ~(1 << (5 + spi->chip_select));
+    if (assert)
+        control_reg |= 1 << (9 + spi->chip_select);
+    else
+        control_reg &= ~(1 << (9 + spi->chip_select));
+    iowrite32(control_reg, base + OFS_CONTROL);
+}
+
+// Move one spi_transfer through the FIFOs, or through the DMA engine when the
+// transfer is long enough to be worth it (caller holds spi_lock)
+static int transferBuffer(struct spi_device *spi, struct spi_transfer *xfer)
+{
+    uint32_t bytes = xfer->bits_per_word <= 8 ? 1 : (xfer->bits_per_word <= 16 ? 2 : 4);
+    size_t words = xfer->len / bytes;
+    size_t done = 0, n, i;
+    uint32_t *tx, *rx;
+    bool useDma;
+    struct spi_dma_descriptor dma;
+    int result = 0;
+
+    while (done < words && result == 0)
+    {
+        useDma = dma_present && words - done >= DMA_MIN_WORDS;
+        n = min_t(size_t, words - done, useDma ? DMA_CHUNK_WORDS : CHUNK_WORDS);
+        tx = useDma ? dma_tx_buffer : tx_chunk;
+        rx = useDma ? dma_rx_buffer : rx_chunk;
+        for (i = 0; i < n; i++)
+            tx[i] = xfer->tx_buf ? getBufferWord(xfer->tx_buf, done + i, bytes) : 0;
+
+        if (useDma)
+        {
+            dma.src = dma_tx_handle;
+            dma.dst = dma_rx_handle;
+            dma.flags = SPI_DMA_TX | SPI_DMA_RX;
+            dma.count = n;
+            dma.cs = spi->chip_select;
+            dma.word_size = xfer->bits_per_word;
+            result = dmaRun(&dma);
+        }
+        else
+            result = transferWords(tx, rx, n, &n);
+
+        if (result == 0 && xfer->rx_buf)
+            for (i = 0; i < n; i++)
+                setBufferWord(xfer->rx_buf, done + i, bytes, rx[i]);
+        done += n;
+    }
+    return result;
+}
+
+static int transferOneMessage(struct spi_controller *controller, struct spi_message *msg)
+{
+    struct spi_device *spi = msg->spi;
+    struct spi_transfer *xfer;
+    bool csActive = false, keepCS = false;
+    uint32_t profiles;
+    int result = 0;
+
+    mutex_lock(&spi_lock);
+    // The profiles would override the settings of the message, so they are
+    // off while it runs and restored for /dev/spi_ip and spi_ip.c users
+    profiles = ioread32(base + OFS_CONTROL) & PROFILE_ENABLE;
+    list_for_each_entry(xfer, &msg->transfers, transfer_list)
+    {
+        configureDevice(spi, xfer);
+        if (!csActive)
+        {
+            setDeviceCS(spi, true);
+            csActive = true;
+        }
+
+        result = transferBuffer(spi, xfer);
+        if (result != 0)
+            break;
+        msg->actual_length += xfer->len;
+
+        if (xfer->delay_usecs)
+            udelay(xfer->delay_usecs);
+
+        // cs_change toggles CS between transfers, or keeps it asserted after
+        // the last transfer of the message
+        if (xfer->cs_change)
+        {
+            if (list_is_last(&xfer->transfer_list, &msg->transfers))
+                keepCS = true;
+            else
+            {
+                setDeviceCS(spi, false);
+                csActive = false;
+                udelay(1);
+            }
+        }
+    }
+    if (csActive && !(result == 0 && keepCS))
+        setDeviceCS(spi, false);
+    if (profiles)
+        iowrite32(ioread32(base + OFS_CONTROL) | profiles, base + OFS_CONTROL);
+    mutex_unlock(&spi_lock);
+
+    msg->status = result;
+    spi_finalize_current_message(controller);
+    return result;
+}
+
+//=============================================================================
+// Platform Driver
+//=============================================================================
+
+static struct resource spi_resources[] =
+{
+    DEFINE_RES_MEM(LW_BRIDGE_BASE + SPI_BASE_OFFSET, SPAN_IN_BYTES),
+    DEFINE_RES_IRQ(SPI_IRQ),
+};
+
+static void freeDmaBuffers(struct platform_device *pdev)
+{
+    dma_present = false;
+    if (dma_tx_buffer)
+        dma_free_coherent(&pdev->dev, DMA_CHUNK_WORDS * sizeof(uint32_t),
+                          dma_tx_buffer, dma_tx_handle);
+    if (dma_rx_buffer)
+        dma_free_coherent(&pdev->dev, DMA_CHUNK_WORDS * sizeof(uint32_t),
+                          dma_rx_buffer, dma_rx_handle);
+    dma_tx_buffer = NULL;
+    dma_rx_buffer = NULL;
+}
+
+static int spi_ip_probe(struct platform_device *pdev)
+{
+    struct spi_controller *controller;
+    struct resource *res;
+    int result;
+
+    res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
+    spi_irq = platform_get_irq(pdev, 0);
+    if (res == NULL || spi_irq < 0)
+        return -ENODEV;
+
+    // Physical to virtual memory map to access spi registers
+    base = (unsigned int*)ioremap_nocache(res->start, resource_size(res));
+    if (base == NULL)
+        return -ENODEV;
+
+    fifo_depth = 1 << ((ioread32(base + OFS_FIFO_LEVEL) >> 12) & 0xF);
+
+    // Register ISR for the FIFO watermark and end of frame interrupts
+    iowrite32(0, base + OFS_INT_ENABLE);
+    result = request_irq(spi_irq, isr, IRQF_SHARED, "SPI IP", &spi_miscdev);
+    if (result != 0)
+        goto err_unmap;
+
+    // Create /dev/spi_ip
+    result = misc_register(&spi_miscdev);
+    if (result != 0)
+        goto err_irq;
+
+    // Allocate DMA bounce buffers if the IP was built with the DMA master
+    if (ioread32(base + OFS_DMA_CONTROL) & DMA_PRESENT)
+    {
+        dma_coerce_mask_and_coherent(&pdev->dev, DMA_BIT_MASK(32));
+        dma_tx_buffer = dma_alloc_coherent(&pdev->dev, DMA_CHUNK_WORDS * sizeof(uint32_t),
+                                           &dma_tx_handle, GFP_KERNEL);
+        dma_rx_buffer = dma_alloc_coherent(&pdev->dev, DMA_CHUNK_WORDS * sizeof(uint32_t),
+                                           &dma_rx_handle, GFP_KERNEL);
+        dma_present = dma_tx_buffer != NULL && dma_rx_buffer != NULL;
+        if (!dma_present)
+            printk(KERN_ALERT "SPI driver: failed to allocate DMA buffers\n");
+    }
+
+    // Register with the kernel SPI core
+    controller = spi_alloc_master(&pdev->dev, 0);
+    if (controller == NULL)
+    {
+        result = -ENOMEM;
+        goto err_dma;
+    }
+    controller->bus_num = -1;
+    controller->num_chipselect = 4;
+    controller->mode_bits = SPI_CPOL | SPI_CPHA;
+    controller->bits_per_word_mask = SPI_BPW_RANGE_MASK(1, 32);
+    controller->max_speed_hz = SYSTEM_CLOCK / 2;
+    controller->min_speed_hz = DIV_ROUND_UP(SYSTEM_CLOCK, 0x3FFFFFF);
+    controller->transfer_one_message = transferOneMessage;
+    platform_set_drvdata(pdev, controller);
+    result = spi_register_controller(controller);
+    if (result != 0)
+    {
+        spi_controller_put(controller);
+        goto err_dma;
+    }
+
+    printk(KERN_INFO "SPI driver: initialized\n");
+    return 0;
+
+err_dma:
+    freeDmaBuffers(pdev);
+    misc_deregister(&spi_miscdev);
+err_irq:
+    free_irq(spi_irq, &spi_miscdev);
+err_unmap:
+    iounmap(base);
+    base = NULL;
+    return result;
+}
+
+static int spi_ip_remove(struct platform_device *pdev)
+{
+    spi_unregister_controller(platform_get_drvdata(pdev));
+    freeDmaBuffers(pdev);
+    misc_deregister(&spi_miscdev);
+    iowrite32(0, base + OFS_INT_ENABLE);
+    free_irq(spi_irq, &spi_miscdev);
+    iounmap(base);
+    base = NULL;
+    return 0;
+}
+
+static struct platform_driver spi_platform_driver =
+{
+    .probe = spi_ip_probe,
+    .remove = spi_ip_remove,
+    .driver =
+    {
+        .name = "spi_ip",
+    },
+};
+
 //=============================================================================
 // Initialization and Exit
 //=============================================================================
@@ -760,64 +1441,86 @@ static int __init initialize_module(void)
 
     printk(KERN_INFO "SPI driver: starting\n");
 
-    // Create qe directory under /sys/kernel
+    // Register the platform driver and the device it binds to (the core has
+    // no device tree node), which maps the registers and sets up the IRQ
+    result = platform_driver_register(&spi_platform_driver);
+    if (result != 0)
+        return result;
+    spi_pdev = platform_device_register_simple("spi_ip", -1, spi_resources, ARRAY_SIZE(spi_resources));
+    if (IS_ERR(spi_pdev))
+    {
+        result = PTR_ERR(spi_pdev);
+        spi_pdev = NULL;
+        goto err_driver;
+    }
+    if (base == NULL)
+    {
+        result = -ENODEV;
+        goto err_device;
+    }
+
+    // Create spi directory under /sys/kernel
     kobj = kobject_create_and_add("spi", kernel_kobj);
     if (!kobj)
     {
         printk(KERN_ALERT "SPI driver: failed to create and add kobj\n");
-        return -ENOENT;
+        result = -ENOENT;
+        goto err_device;
     }
 
     result = sysfs_create_file(kobj, &baud_rateAttr.attr);
     if (result !=0)
-        return result;
+        goto err_kobj;
     result = sysfs_create_file(kobj, &word_sizeAttr.attr);
     if (result !=0)
-        return result;
+        goto err_kobj;
+    result = sysfs_create_file(kobj, &frame_lengthAttr.attr);
+    if (result !=0)
+        goto err_kobj;
     result = sysfs_create_file(kobj, &cs_selectAttr.attr);
     if (result !=0)
-        return result;
+        goto err_kobj;
     
     // Create device0-3 groups
     result = sysfs_create_group(kobj, &device0);
     if (result !=0)
-        return result;
+        goto err_kobj;
     result = sysfs_create_group(kobj, &device1);
     if (result !=0)
-        return result;
+        goto err_kobj;
     result = sysfs_create_group(kobj, &device2);
     if (result !=0)
-        return result;
+        goto err_kobj;
     result = sysfs_create_group(kobj, &device3);
     if (result !=0)
-        return result;
+        goto err_kobj;
 
     result = sysfs_create_file(kobj, &tx_dataAttr.attr);
     if (result !=0)
-        return result;
+        goto err_kobj;
     result = sysfs_create_file(kobj, &rx_dataAttr.attr);
     if (result !=0)
-        return result;
-
-
-    // Physical to virtual memory map to access gpio registers
-    base = (unsigned int*)ioremap_nocache(LW_BRIDGE_BASE + SPI_BASE_OFFSET,
-                                          SPAN_IN_BYTES);
-    if (base == NULL)
-        return -ENODEV;
-
-    printk(KERN_INFO "SPI driver: initialized\n");
+        goto err_kobj;
 
     return 0;
+
+err_kobj:
+    kobject_put(kobj);
+err_device:
+    platform_device_unregister(spi_pdev);
+err_driver:
+    platform_driver_unregister(&spi_platform_driver);
+    return result;
 }
 
 
 static void __exit exit_module(void)
 {
     kobject_put(kobj);
+    platform_device_unregister(spi_pdev);
+    platform_driver_unregister(&spi_platform_driver);
     printk(KERN_INFO "SPI driver: exit\n");
 }
 
 module_init(initialize_module);
 module_exit(exit_module);
-
@@ -0,0 +1,56 @@
+// SPI IP
+// SPI IP Driver Kernel Interface
+// CSE4356-SoC | Fall 2021 | Term Project
+// Deborah Jahaj and Nathan Fusselman
+
+//=============================================================================
+// Hardware Target
+//=============================================================================
+
+// Target Platform: DE1-SoC Board
+
+// Hardware configuration:
+// SPI Port:
+//   GPIO_0[7,9,11,13,15,17,19] are used as a SPI interface
+// HPS interface:
+//   Mapped to offset of 8000 in light-weight MM interface aperature
+//   DMA master connected to the HPS through the FPGA-to-HPS bridge
+
+//=============================================================================
+
+#ifndef SPI_DRIVER_H_
+#define SPI_DRIVER_H_
+
+#include <linux/types.h>
+
+//=============================================================================
+// DMA Descriptors
+//=============================================================================
+
+#define SPI_DMA_TX 0x1
+#define SPI_DMA_RX 0x2
+
+// src and dst are bus addresses of word buffers (dma_alloc_coherent or
+// dma_map_single against the spi_ip device); src is only read with
+// SPI_DMA_TX in flags (zeros are clocked out otherwise) and dst is only
+// written with SPI_DMA_RX (the received words are discarded otherwise)
+struct spi_dma_descriptor
+{
+    dma_addr_t src;
+    dma_addr_t dst;
+    uint32_t count;
+    uint8_t cs;
+    uint8_t word_size;
+    uint8_t flags;
+};
+
+//=============================================================================
+// Subroutines
+//=============================================================================
+
+struct device *spiDmaDevice(void);
+int spiDmaSubmit(const struct spi_dma_descriptor *desc);
+void spiBusLock(void);
+void spiBusUnlock(void);
+
+#endif
@@ -19,253 +19,433 @@
 
 #include <stdint.h>          // C99 integer types -- uint32_t
 #include <stdbool.h>         // bool
-#include <fcntl.h>           // open
+#include <stdlib.h>          // calloc, free
 #include <math.h>            // math
-#include <sys/mman.h>        // mmap
-#include <unistd.h>          // close
+#include <unistd.h>          // usleep
 #include "../address_map.h"  // address map
+#include "../lw_bridge.h"    // lw bridge
 #include "spi_ip.h"          // gpio
 #include "spi_regs.h"        // registers
+#if defined(SPI_STANDIN)
+#include "spi_standin.h"     // software register model
+#elif defined(SPI_COSIM)
+#include "spi_cosim.h"       // RTL co-simulation
+#elif defined(VIRTUAL_DE1SOC)
+#include "../VIRTUAL/virtual_bus.h" // virtual bus
+#endif
 #include <stdio.h>
 
 #define SYSTEM_CLOCK 50000000
+#define TRANSFER_SPIN_POLLS 64      // stalled polls before spiDevTransfer sleeps
+#define TRANSFER_SLEEP_US 10        // sleep per stalled poll after that
+#define TRANSFER_TIMEOUT_US 100000  // stall allowed on top of one word time
+
+struct spi_dev
+{
+    uint32_t *base;          // window in the bridge mapping
+    uint32_t offset;         // offset in the light-weight aperature
+    uint16_t fifoDepth;
+
+    // Shadows of CONTROL and BRD so setters are a single store and getters
+    // need no bus access; spiDevSync() reloads them if another client
+    // changed the core
+    uint32_t controlShadow;
+    uint32_t brdShadow;
+};
 
 //=============================================================================
 // Global variables
 //=============================================================================
 
-uint32_t *base = NULL;
+// Register accesses made through readReg/writeReg, counted when built with
+// SPI_COUNT_MMIO (spi_bench)
+uint64_t spiMmioCount = 0;
+
+// Instance used by the single-instance calls
+static spi_t *spi0 = NULL;
 
 //=============================================================================
 // Subroutines
 //=============================================================================
 
-bool spiOpen()
+// Every register access goes through these, so a build with SPI_STANDIN
+// runs against the software model in spi_standin.c, a build with SPI_COSIM
+// against the spi_dev RTL and a build with VIRTUAL_DE1SOC against
+// de1soc_sim instead of /dev/mem
+static inline uint32_t readReg(spi_t *spi, uint8_t ofs)
+{
+#ifdef SPI_COUNT_MMIO
+    spiMmioCount++;
+#endif
+#if defined(SPI_STANDIN)
+    return standinRead(ofs);
+#elif defined(SPI_COSIM)
+    return cosimRead(ofs);
+#elif defined(VIRTUAL_DE1SOC)
+    return vbusRead(spi->offset + ofs * 4);
+#else
+    return *(spi->base+ofs);
+#endif
+}
+
+static inline void writeReg(spi_t *spi, uint8_t ofs, uint32_t data)
+{
+#ifdef SPI_COUNT_MMIO
+    spiMmioCount++;
+#endif
+#if defined(SPI_STANDIN)
+    standinWrite(ofs, data);
+#elif defined(SPI_COSIM)
+    cosimWrite(ofs, data);
+#elif defined(VIRTUAL_DE1SOC)
+    vbusWrite(spi->offset + ofs * 4, data);
+#else
+    *(spi->base+ofs) = data;
+#endif
+}
+
+// Fixed waits, counted in simulated time under SPI_COSIM
+static inline void spiDelay(uint32_t us)
+{
+#ifdef SPI_COSIM
+    cosimDelay(us);
+#else
+    usleep(us);
+#endif
+}
+
+// The standin and co-simulation builds have a single core behind every
+// handle, which is reset when a handle is opened
+spi_t *spiDevOpen(uint32_t offset)
 {
-    // Open /dev/mem
-    int file = open("/dev/mem", O_RDWR | O_SYNC);
-    bool bOK = (file >= 0);
-    if (bOK)
+    spi_t *spi = calloc(1, sizeof(spi_t));
+    if (spi == NULL) return NULL;
+    spi->offset = offset;
+#if defined(SPI_STANDIN)
+    standinReset();
+#elif defined(SPI_COSIM)
+    cosimReset();
+#else
+    if (!lwBridgeMap(offset, SPAN_IN_BYTES, &spi->base))
     {
-        // Create a map from the physical memory location of
-        // /dev/mem at an offset to LW avalon interface
-        // with an aperature of SPAN_IN_BYTES bytes
-        // to any location in the virtual 32-bit memory space of the process
-        base = mmap(NULL, SPAN_IN_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED,
-                    file, LW_BRIDGE_BASE + SPI_BASE_OFFSET);
-        bOK = (base != MAP_FAILED);
-
-        // Close /dev/mem
-        close(file);
+        free(spi);
+        return NULL;
     }
-    return bOK;
+#endif
+    spiDevGetFifoDepth(spi, &spi->fifoDepth);
+    spiDevSync(spi);
+    return spi;
 }
 
-bool getStatus(bool *state)
+void spiDevClose(spi_t *spi)
+{
+    if (spi == NULL) return;
+#if !defined(SPI_STANDIN) && !defined(SPI_COSIM)
+    lwBridgeUnmap();
+#endif
+    free(spi);
+}
+
+bool spiDevSync(spi_t *spi)
 {
-    uint32_t control_reg = *(base+OFS_CONTROL);
-    *state = control_reg & (1 << 15);
+    spi->controlShadow = readReg(spi, OFS_CONTROL);
+    spi->brdShadow = readReg(spi, OFS_BRD);
     return true;
 }
 
-bool setStatus(bool state)
+static void writeControl(spi_t *spi, uint32_t control_reg)
+{
+    spi->controlShadow = control_reg;
+    writeReg(spi, OFS_CONTROL, control_reg);
+}
+
+bool spiDevGetStatus(spi_t *spi, bool *state)
+{
+    *state = spi->controlShadow & (1 << 15);
+    return true;
+}
+
+bool spiDevSetStatus(spi_t *spi, bool state)
 {
     if (state) {
-        *(base+OFS_CONTROL) |= (1 << 15);
+        writeControl(spi, spi->controlShadow | (1 << 15));
     } else {
-        *(base+OFS_CONTROL) &= ~(1 << 15);
+        writeControl(spi, spi->controlShadow & ~(1 << 15));
     }
-    bool setState;
-    getStatus(&setState);
-    return state == setState;
+    return true;
 }
 
-bool sendData(uint32_t data)
+bool spiDevSendData(spi_t *spi, uint32_t data)
 {
     bool empty, full, ovr;
-    getTxStatus(&empty, &full, &ovr);
+    spiDevGetTxStatus(spi, &empty, &full, &ovr);
     if (full) return false;
-    *(base+OFS_DATA) = data;
-    usleep(10);
+    writeReg(spi, OFS_DATA, data);
+    spiDelay(10);
     return true;
 }
 
-bool readData(uint32_t *data)
+// Queues a word for a specific device and word size without changing
+// CS_SELECT, so words for several devices can share the Tx FIFO
+bool spiDevSendTaggedData(spi_t *spi, uint8_t dev, uint8_t size, uint32_t data)
+{
+    if (dev > 3 || size < 1 || size > 25) return false;
+    bool empty, full, ovr;
+    spiDevGetTxStatus(spi, &empty, &full, &ovr);
+    if (full) return false;
+    writeReg(spi, OFS_TAGGED_DATA, TAG(dev, size) | (data & TAG_DATA_MASK));
+    return true;
+}
+
+bool spiDevReadData(spi_t *spi, uint32_t *data)
 {
     bool empty, full, ovr;
-    getRxStatus(&empty, &full, &ovr);
+    spiDevGetRxStatus(spi, &empty, &full, &ovr);
     if (empty) return false;
-    *data = *(base+OFS_DATA);
-    usleep(10);
+    *data = readReg(spi, OFS_DATA);
+    spiDelay(10);
     return true;
 }
 
-bool getRxStatus(bool *empty, bool *full, bool *ovr)
+// Time in us to shift a 32-bit word on the selected device, from its
+// profile divisor when the profiles are enabled
+static uint32_t wordTimeUs(spi_t *spi)
+{
+    uint32_t divisor = spi->brdShadow;
+    if (spi->controlShadow & PROFILE_ENABLE)
+        divisor = readReg(spi, OFS_PROFILE + ((spi->controlShadow >> 13) & 0x3)) >> 8;
+    return (32 * ((divisor >> 6) + 1)) / (SYSTEM_CLOCK / 1000000) + 1;
+}
+
+// Drops the queued words, lets the one being shifted finish and empties
+// both FIFOs, so nothing left over is taken as a reply later
+static void spiDevFlush(spi_t *spi)
+{
+    writeReg(spi, OFS_STATUS, 1 << 7);
+    spiDelay(wordTimeUs(spi));
+    writeReg(spi, OFS_STATUS, (1 << 7) | (1 << 6));
+}
+
+// Full-duplex transfer of n words, keeping the Tx FIFO topped up from the
+// Tx count and draining the Rx FIFO as words arrive (no fixed sleeps)
+// tx may be NULL to clock out zeros, rx may be NULL to discard received words
+// Words left in the FIFOs by earlier calls and stale overflow flags are
+// cleared first. The transfer fails, flushing both FIFOs, on an overflow or
+// when no word moves for a word time plus TRANSFER_TIMEOUT_US (e.g. another
+// client disabled the core)
+bool spiDevTransfer(spi_t *spi, const uint32_t *tx, uint32_t *rx, size_t n)
+{
+    size_t sent = 0, received = 0;
+    uint32_t level_reg, data;
+    uint16_t txCount, rxCount, txFree;
+    uint32_t polls = 0, stalledUs = 0, limitUs;
+    bool progress;
+
+    if (!(spi->controlShadow & (1 << 15))) return false;
+    if (!(readReg(spi, OFS_STATUS) & (1 << 5)))
+        spiDevFlush(spi);
+    writeReg(spi, OFS_STATUS, (1 << 6) | (1 << 3) | (1 << 0));
+    limitUs = wordTimeUs(spi) + TRANSFER_TIMEOUT_US;
+    while (received < n)
+    {
+        level_reg = readReg(spi, OFS_FIFO_LEVEL);
+        txCount = level_reg & 0xFFF;
+        rxCount = (level_reg >> 16) & 0xFFF;
+        progress = false;
+
+        // Drain everything the Rx FIFO holds
+        while (rxCount > 0 && received < n)
+        {
+            data = readReg(spi, OFS_DATA);
+            if (rx) rx[received] = data;
+            received++;
+            rxCount--;
+            progress = true;
+        }
+
+        // Fill the Tx FIFO, but never have more words in flight than the
+        // Rx FIFO can hold so the receive side cannot overflow
+        txFree = spi->fifoDepth - txCount;
+        while (txFree > 0 && sent < n && (sent - received) < spi->fifoDepth)
+        {
+            writeReg(spi, OFS_DATA, tx ? tx[sent] : 0);
+            sent++;
+            txFree--;
+            progress = true;
+        }
+
+        if (progress)
+        {
+            polls = 0;
+            stalledUs = 0;
+            continue;
+        }
+
+        // Only check for overflow when stalled, as it keeps words from arriving
+        if ((readReg(spi, OFS_STATUS) & ((1 << 0) | (1 << 3))) || stalledUs >= limitUs)
+        {
+            spiDevFlush(spi);
+            return false;
+        }
+        if (++polls > TRANSFER_SPIN_POLLS)
+        {
+            spiDelay(TRANSFER_SLEEP_US);
+            stalledUs += TRANSFER_SLEEP_US;
+        }
+    }
+    return true;
+}
+
+bool spiDevGetRxStatus(spi_t *spi, bool *empty, bool *full, bool *ovr)
 {
-    uint32_t status_reg = *(base+OFS_STATUS);
+    uint32_t status_reg = readReg(spi, OFS_STATUS);
     *ovr = status_reg & ((1 << 0) << (3 * 0));
     *full = status_reg & ((1 << 1) << (3 * 0));
     *empty = status_reg & ((1 << 2) << (3 * 0));
     return true;
 }
 
-bool getTxStatus(bool *empty, bool *full, bool *ovr)
+bool spiDevGetTxStatus(spi_t *spi, bool *empty, bool *full, bool *ovr)
 {
-    uint32_t status_reg = *(base+OFS_STATUS);
+    uint32_t status_reg = readReg(spi, OFS_STATUS);
     *ovr = status_reg & ((1 << 0) << (3 * 1));
     *full = status_reg & ((1 << 1) << (3 * 1));
     *empty = status_reg & ((1 << 2) << (3 * 1));
     return true;
 }
 
-bool getRxCount(uint8_t *count)
+bool spiDevGetRxCount(spi_t *spi, uint16_t *count)
 {
-    uint32_t status_reg = *(base+OFS_STATUS);
-    *count = (status_reg >> 8) & 0xF;
+    uint32_t level_reg = readReg(spi, OFS_FIFO_LEVEL);
+    *count = (level_reg >> 16) & 0xFFF;
     return true;
 }
 
-bool getTxCount(uint8_t *count)
+bool spiDevGetTxCount(spi_t *spi, uint16_t *count)
 {
-    uint32_t status_reg = *(base+OFS_STATUS);
-    *count = (status_reg >> 12) & 0xF;
+    uint32_t level_reg = readReg(spi, OFS_FIFO_LEVEL);
+    *count = level_reg & 0xFFF;
     return true;
 }
 
-bool clearRxOV()
+bool spiDevGetFifoDepth(spi_t *spi, uint16_t *depth)
 {
-    *(base+OFS_STATUS) = (1 << (3 * 0));
+    uint32_t level_reg = readReg(spi, OFS_FIFO_LEVEL);
+    *depth = 1 << ((level_reg >> 12) & 0xF);
+    return true;
+}
+
+bool spiDevClearRxOV(spi_t *spi)
+{
+    writeReg(spi, OFS_STATUS, (1 << (3 * 0)));
     bool empty, full, ovr;
-    getRxStatus(&empty, &full, &ovr);
+    spiDevGetRxStatus(spi, &empty, &full, &ovr);
     return !ovr;
 }
 
-bool clearTxOV()
+bool spiDevClearTxOV(spi_t *spi)
 {
-    *(base+OFS_STATUS) = (1 << (3 * 1));
+    writeReg(spi, OFS_STATUS, (1 << (3 * 1)));
     bool empty, full, ovr;
-    getTxStatus(&empty, &full, &ovr);
+    spiDevGetTxStatus(spi, &empty, &full, &ovr);
     return !ovr;
 }
 
-bool resetRx()
+bool spiDevResetRx(spi_t *spi)
 {
-    *(base+OFS_STATUS) = (1 << 6);
+    writeReg(spi, OFS_STATUS, (1 << 6));
     return true;
 }
 
-bool resetTx()
+bool spiDevResetTx(spi_t *spi)
 {
-    *(base+OFS_STATUS) = (1 << 7);
+    writeReg(spi, OFS_STATUS, (1 << 7));
     return true;
 }
 
-bool getWordsize(uint8_t *size)
+bool spiDevGetWordsize(spi_t *spi, uint8_t *size)
 {
-    uint32_t control_reg = *(base+OFS_CONTROL);
-    *size = control_reg & 0x1F;
-    *size = *size + 1;
+    *size = (spi->controlShadow & 0x1F) + 1;
     return true;
 }
 
-bool setWordsize(uint8_t size)
+bool spiDevSetWordsize(spi_t *spi, uint8_t size)
 {
-    if (size > 32) return false;
-    *(base+OFS_CONTROL) &= ~0x1F;
-    *(base+OFS_CONTROL) |= (size - 1) & 0x1F;
+    if (size < 1 || size > 32) return false;
+    writeControl(spi, (spi->controlShadow & ~0x1F) | ((size - 1) & 0x1F));
     return true;
 }
 
-bool getDevice(uint8_t *dev)
+bool spiDevGetDevice(spi_t *spi, uint8_t *dev)
 {
-    if (*dev > 3) return false;
-    uint32_t control_reg = *(base+OFS_CONTROL);
-    *dev = (control_reg >> 13) & 0x3;
+    *dev = (spi->controlShadow >> 13) & 0x3;
     return true;
 }
 
-bool setDevice(uint8_t dev)
+bool spiDevSetDevice(spi_t *spi, uint8_t dev)
 {
     if (dev > 3) return false;
-    *(base+OFS_CONTROL) &= ~(0x3 << 13);
-    *(base+OFS_CONTROL) |= ((dev & 0x3) << 13);
-    uint8_t newDev;
-    getDevice(&newDev);
-    return dev == newDev;
+    writeControl(spi, (spi->controlShadow & ~(0x3 << 13)) | ((dev & 0x3) << 13));
+    return true;
 }
 
-bool getCSModeForDevice(uint8_t dev, bool *mode)
+bool spiDevGetCSModeForDevice(spi_t *spi, uint8_t dev, bool *mode)
 {
     if (dev > 3) return false;
-    uint32_t control_reg = *(base+OFS_CONTROL);
-    *mode = (control_reg >> (5 + dev)) & 0x1;
+    *mode = (spi->controlShadow >> (5 + dev)) & 0x1;
     return true;
 }
 
-bool setCSModeForDevice(uint8_t dev, bool mode)
+bool spiDevSetCSModeForDevice(spi_t *spi, uint8_t dev, bool mode)
 {
     if (dev > 3) return false;
     if (mode) {
-        *(base+OFS_CONTROL) |= (1 << (5 + dev));
+        writeControl(spi, spi->controlShadow | (1 << (5 + dev)));
     } else {
-        *(base+OFS_CONTROL) &= ~(1 << (5 + dev));
+        writeControl(spi, spi->controlShadow & ~(1 << (5 + dev)));
     }
-    bool newMode;
-    getCSModeForDevice(dev, &newMode);
-    return mode == newMode;
+    return true;
 }
 
-bool getCSEnableForDevice(uint8_t dev, bool *enable)
+bool spiDevGetCSEnableForDevice(spi_t *spi, uint8_t dev, bool *enable)
 {
     if (dev > 3) return false;
-    uint32_t control_reg = *(base+OFS_CONTROL);
-    *enable = (control_reg >> (9 + dev)) & 0x1;
+    *enable = (spi->controlShadow >> (9 + dev)) & 0x1;
     return true;
 }
 
-bool setCSEnableForDevice(uint8_t dev, bool enable)
+bool spiDevSetCSEnableForDevice(spi_t *spi, uint8_t dev, bool enable)
 {
     if (dev > 3) return false;
     if (enable) {
-        *(base+OFS_CONTROL) |= (1 << (9 + dev));
+        writeControl(spi, spi->controlShadow | (1 << (9 + dev)));
     } else {
-        *(base+OFS_CONTROL) &= ~(1 << (9 + dev));
+        writeControl(spi, spi->controlShadow & ~(1 << (9 + dev)));
     }
-    bool newEnable;
-    getCSEnableForDevice(dev, &newEnable);
-    return enable == newEnable;
+    return true;
 }
 
-bool getSPIModeForDevice(uint8_t dev, bool *spo, bool *sph)
+bool spiDevGetSPIModeForDevice(spi_t *spi, uint8_t dev, bool *spo, bool *sph)
 {
     if (dev > 3) return false;
-    uint32_t control_reg = *(base+OFS_CONTROL);
-    *spo = (control_reg >> (16 + (dev * 2))) & 0x1;
-    *sph = (control_reg >> (17 + (dev * 2))) & 0x1;
+    *spo = (spi->controlShadow >> (17 + (dev * 2))) & 0x1;
+    *sph = *spo ^ ((spi->controlShadow >> (16 + (dev * 2))) & 0x1);
     return true;
 }
 
-bool setSPIModeForDevice(uint8_t dev, bool spo, bool sph)
+bool spiDevSetSPIModeForDevice(spi_t *spi, uint8_t dev, bool spo, bool sph)
 {
     if (dev > 3) return false;
-    if (spo) {
-        *(base+OFS_CONTROL) |= (1 << (16 + (dev * 2)));
-    } else {
-        *(base+OFS_CONTROL) &= ~(1 << (16 + (dev * 2)));
-    }
-    if (sph) {
-        *(base+OFS_CONTROL) |= (1 << (17 + (dev * 2)));
-    } else {
-        *(base+OFS_CONTROL) &= ~(1 << (17 + (dev * 2)));
-    }
-    bool newSPO, newSPH;
-    getSPIModeForDevice(dev, &newSPO, &newSPH);
-    return spo == newSPO && sph == newSPH;
+    uint32_t control_reg = spi->controlShadow & ~(0x3 << (16 + (dev * 2)));
+    control_reg |= (spo << (17 + (dev * 2))) | ((spo ^ sph) << (16 + (dev * 2)));
+    writeControl(spi, control_reg);
+    return true;
 }
 
-bool getBRD(double *brd)
+// Converts between a baud rate and the fixed point divisor used by the BRD
+// register and the profile registers (6 fractional bits)
+static double decodeBRD(uint32_t raw_brd)
 {
-    uint32_t raw_brd = *(base+OFS_BRD);
     double divisor = raw_brd >> 6;
     uint8_t i;
     for (i = 0; i < 6; i++) {
@@ -273,11 +453,10 @@ bool getBRD(double *brd)
             divisor += pow(2,-i);
         }
     }
-    *brd = ((double)SYSTEM_CLOCK / divisor);
-    return true;
+    return ((double)SYSTEM_CLOCK / divisor);
 }
 
-bool setBRD(double brd)
+static uint32_t encodeBRD(double brd)
 {
     double divisor = ((double)SYSTEM_CLOCK / brd);
     uint32_t brd_value = ((uint32_t)divisor) << 6;
@@ -288,15 +467,317 @@ bool setBRD(double brd)
             brd_value |= 1 << (5 - i);
         }
     }
-    *(base+OFS_BRD) = brd_value;
+    return brd_value;
+}
+
+bool spiDevGetBRD(spi_t *spi, double *brd)
+{
+    *brd = decodeBRD(spi->brdShadow);
+    return true;
+}
+
+bool spiDevSetBRD(spi_t *spi, double brd)
+{
+    spi->brdShadow = encodeBRD(brd);
+    writeReg(spi, OFS_BRD, spi->brdShadow);
     double check;
-    getBRD(&check);
+    spiDevGetBRD(spi, &check);
     return check > (brd - (brd*0.001)) && check < (brd + (brd*0.001));
 }
 
-bool getDebug(uint16_t *debug)
+// Applies a whole configuration with one CONTROL store and one BRD store
+bool spiDevConfigure(spi_t *spi, const struct spi_config *config)
+{
+    uint8_t dev;
+    if (config->wordSize < 1 || config->wordSize > 32 || config->device > 3) return false;
+    uint32_t control_reg = spi->controlShadow & PROFILE_ENABLE;
+    control_reg |= (config->wordSize - 1) & 0x1F;
+    control_reg |= (config->device & 0x3) << 13;
+    if (config->enable) control_reg |= (1 << 15);
+    for (dev = 0; dev < 4; dev++)
+    {
+        control_reg |= config->csAuto[dev] << (5 + dev);
+        control_reg |= config->csEnable[dev] << (9 + dev);
+        control_reg |= config->spo[dev] << (17 + (dev * 2));
+        control_reg |= (config->spo[dev] ^ config->sph[dev]) << (16 + (dev * 2));
+    }
+    writeControl(spi, control_reg);
+    if (config->brd > 0)
+        return spiDevSetBRD(spi, config->brd);
+    return true;
+}
+
+bool spiDevGetConfig(spi_t *spi, struct spi_config *config)
+{
+    uint8_t dev;
+    spiDevGetWordsize(spi, &config->wordSize);
+    spiDevGetDevice(spi, &config->device);
+    spiDevGetStatus(spi, &config->enable);
+    for (dev = 0; dev < 4; dev++)
+    {
+        spiDevGetCSModeForDevice(spi, dev, &config->csAuto[dev]);
+        spiDevGetCSEnableForDevice(spi, dev, &config->csEnable[dev]);
+        spiDevGetSPIModeForDevice(spi, dev, &config->spo[dev], &config->sph[dev]);
+    }
+    spiDevGetBRD(spi, &config->brd);
+    return true;
+}
+
+// Number of words sent under one chip select assertion (0 or 1 for one per word)
+bool spiDevGetFrameLength(spi_t *spi, uint16_t *length)
+{
+    *length = readReg(spi, OFS_FRAME_LENGTH) & 0xFFFF;
+    return true;
+}
+
+bool spiDevSetFrameLength(spi_t *spi, uint16_t length)
+{
+    writeReg(spi, OFS_FRAME_LENGTH, length);
+    uint16_t newLength;
+    spiDevGetFrameLength(spi, &newLength);
+    return length == newLength;
+}
+
+// When enabled the profile of the selected device replaces the global word
+// size, SPI mode, CS auto and baud rate, so switching devices is one write
+bool spiDevGetProfileEnable(spi_t *spi, bool *enable)
+{
+    *enable = spi->controlShadow & PROFILE_ENABLE;
+    return true;
+}
+
+bool spiDevSetProfileEnable(spi_t *spi, bool enable)
+{
+    if (enable) {
+        writeControl(spi, spi->controlShadow | PROFILE_ENABLE);
+    } else {
+        writeControl(spi, spi->controlShadow & ~PROFILE_ENABLE);
+    }
+    return true;
+}
+
+// Profile layout: [4:0] word size - 1, [5] SPO ^ SPH, [6] SPO, [7] CS auto,
+// [31:8] baud rate divisor
+bool spiDevGetProfileForDevice(spi_t *spi, uint8_t dev, uint8_t *size, bool *spo, bool *sph, bool *csAuto, double *brd)
+{
+    if (dev > 3) return false;
+    uint32_t profile_reg = readReg(spi, OFS_PROFILE+dev);
+    *size = (profile_reg & 0x1F) + 1;
+    *spo = (profile_reg >> 6) & 0x1;
+    *sph = *spo ^ ((profile_reg >> 5) & 0x1);
+    *csAuto = (profile_reg >> 7) & 0x1;
+    *brd = decodeBRD(profile_reg >> 8);
+    return true;
+}
+
+bool spiDevSetProfileForDevice(spi_t *spi, uint8_t dev, uint8_t size, bool spo, bool sph, bool csAuto, double brd)
 {
-    uint32_t status_reg = *(base+OFS_STATUS);
+    if (dev > 3 || size < 1 || size > 32) return false;
+    uint32_t brd_value = encodeBRD(brd);
+    if (brd_value > 0xFFFFFF) return false;
+    uint32_t profile_reg = (brd_value << 8) | (csAuto << 7) | (spo << 6) | ((spo ^ sph) << 5) | ((size - 1) & 0x1F);
+    writeReg(spi, OFS_PROFILE+dev, profile_reg);
+    return readReg(spi, OFS_PROFILE+dev) == profile_reg;
+}
+
+bool spiDevGetDebug(spi_t *spi, uint16_t *debug)
+{
+    uint32_t status_reg = readReg(spi, OFS_STATUS);
     *debug = status_reg >> 16;
     return true;
-}
\ No newline at end of file
+}
+
+//=============================================================================
+// Single-instance calls on the core at SPI_BASE_OFFSET
+//=============================================================================
+
+bool spiOpen()
+{
+    if (spi0 == NULL) spi0 = spiDevOpen(SPI_BASE_OFFSET);
+    return spi0 != NULL;
+}
+
+bool spiSync()
+{
+    return spiDevSync(spi0);
+}
+
+bool spiConfigure(const struct spi_config *config)
+{
+    return spiDevConfigure(spi0, config);
+}
+
+bool spiGetConfig(struct spi_config *config)
+{
+    return spiDevGetConfig(spi0, config);
+}
+
+bool getStatus(bool *state)
+{
+    return spiDevGetStatus(spi0, state);
+}
+
+bool setStatus(bool state)
+{
+    return spiDevSetStatus(spi0, state);
+}
+
+bool sendData(uint32_t data)
+{
+    return spiDevSendData(spi0, data);
+}
+
+bool sendTaggedData(uint8_t dev, uint8_t size, uint32_t data)
+{
+    return spiDevSendTaggedData(spi0, dev, size, data);
+}
+
+bool readData(uint32_t *data)
+{
+    return spiDevReadData(spi0, data);
+}
+
+bool spiTransfer(const uint32_t *tx, uint32_t *rx, size_t n)
+{
+    return spiDevTransfer(spi0, tx, rx, n);
+}
+
+bool getRxStatus(bool *empty, bool *full, bool *ovr)
+{
+    return spiDevGetRxStatus(spi0, empty, full, ovr);
+}
+
+bool getTxStatus(bool *empty, bool *full, bool *ovr)
+{
+    return spiDevGetTxStatus(spi0, empty, full, ovr);
+}
+
+bool getRxCount(uint16_t *count)
+{
+    return spiDevGetRxCount(spi0, count);
+}
+
+bool getTxCount(uint16_t *count)
+{
+    return spiDevGetTxCount(spi0, count);
+}
+
+bool getFifoDepth(uint16_t *depth)
+{
+    return spiDevGetFifoDepth(spi0, depth);
+}
+
+bool clearRxOV()
+{
+    return spiDevClearRxOV(spi0);
+}
+
+bool clearTxOV()
+{
+    return spiDevClearTxOV(spi0);
+}
+
+bool resetRx()
+{
+    return spiDevResetRx(spi0);
+}
+
+bool resetTx()
+{
+    return spiDevResetTx(spi0);
+}
+
+bool getWordsize(uint8_t *size)
+{
+    return spiDevGetWordsize(spi0, size);
+}
+
+bool setWordsize(uint8_t size)
+{
+    return spiDevSetWordsize(spi0, size);
+}
+
+bool getDevice(uint8_t *dev)
+{
+    return spiDevGetDevice(spi0, dev);
+}
+
+bool setDevice(uint8_t dev)
+{
+    return spiDevSetDevice(spi0, dev);
+}
+
+bool getCSModeForDevice(uint8_t dev, bool *mode)
+{
+    return spiDevGetCSModeForDevice(spi0, dev, mode);
+}
+
+bool setCSModeForDevice(uint8_t dev, bool mode)
+{
+    return spiDevSetCSModeForDevice(spi0, dev, mode);
+}
+
+bool getCSEnableForDevice(uint8_t dev, bool *enable)
+{
+    return spiDevGetCSEnableForDevice(spi0, dev, enable);
+}
+
+bool setCSEnableForDevice(uint8_t dev, bool enable)
+{
+    return spiDevSetCSEnableForDevice(spi0, dev, enable);
+}
+
+bool getSPIModeForDevice(uint8_t dev, bool *spo, bool *sph)
+{
+    return spiDevGetSPIModeForDevice(spi0, dev, spo, sph);
+}
+
+bool setSPIModeForDevice(uint8_t dev, bool spo, bool sph)
+{
+    return spiDevSetSPIModeForDevice(spi0, dev, spo, sph);
+}
+
+bool getBRD(double *brd)
+{
+    return spiDevGetBRD(spi0, brd);
+}
+
+bool setBRD(double brd)
+{
+    return spiDevSetBRD(spi0, brd);
+}
+
+bool getFrameLength(uint16_t *length)
+{
+    return spiDevGetFrameLength(spi0, length);
+}
+
+bool setFrameLength(uint16_t length)
+{
+    return spiDevSetFrameLength(spi0, length);
+}
+
+bool getProfileEnable(bool *enable)
+{
+    return spiDevGetProfileEnable(spi0, enable);
+}
+
+bool setProfileEnable(bool enable)
+{
+    return spiDevSetProfileEnable(spi0, enable);
+}
+
+bool getProfileForDevice(uint8_t dev, uint8_t *size, bool *spo, bool *sph, bool *csAuto, double *brd)
+{
+    return spiDevGetProfileForDevice(spi0, dev, size, spo, sph, csAuto, brd);
+}
+
+bool setProfileForDevice(uint8_t dev, uint8_t size, bool spo, bool sph, bool csAuto, double brd)
+{
+    return spiDevSetProfileForDevice(spi0, dev, size, spo, sph, csAuto, brd);
+}
+
+bool getDebug(uint16_t *debug)
+{
+    return spiDevGetDebug(spi0, debug);
+}
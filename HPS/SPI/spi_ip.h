@@ -22,23 +22,110 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
+
+//=============================================================================
+// Configuration
+//=============================================================================
+
+// Complete CONTROL and BRD contents, applied by spiConfigure in one write each
+struct spi_config
+{
+    uint8_t wordSize;   // 1-32 bits
+    uint8_t device;     // selected chip select 0-3
+    bool enable;
+    bool csAuto[4];
+    bool csEnable[4];
+    bool spo[4];
+    bool sph[4];
+    double brd;         // baud rate in Hz, 0 leaves BRD unchanged
+};
+
+// Handle for one SPI IP instance
+typedef struct spi_dev spi_t;
+
+//=============================================================================
+// Global variables
+//=============================================================================
+
+// Register accesses so far, only counted when built with SPI_COUNT_MMIO
+extern uint64_t spiMmioCount;
 
 //=============================================================================
 // Subroutines
 //=============================================================================
 
+// Instances at any offset in the light-weight aperature (address_map.h or
+// lwBridgeFindCore), all sharing one mapping of the bridge
+spi_t *spiDevOpen(uint32_t offset);
+void spiDevClose(spi_t *spi);
+bool spiDevSync(spi_t *spi);
+bool spiDevConfigure(spi_t *spi, const struct spi_config *config);
+bool spiDevGetConfig(spi_t *spi, struct spi_config *config);
+
+bool spiDevGetStatus(spi_t *spi, bool *state);
+bool spiDevSetStatus(spi_t *spi, bool state);
+
+bool spiDevSendData(spi_t *spi, uint32_t data);
+bool spiDevSendTaggedData(spi_t *spi, uint8_t dev, uint8_t size, uint32_t data);
+bool spiDevReadData(spi_t *spi, uint32_t *data);
+bool spiDevTransfer(spi_t *spi, const uint32_t *tx, uint32_t *rx, size_t n);
+
+bool spiDevGetRxStatus(spi_t *spi, bool *empty, bool *full, bool *ovr);
+bool spiDevGetTxStatus(spi_t *spi, bool *empty, bool *full, bool *ovr);
+bool spiDevGetRxCount(spi_t *spi, uint16_t *count);
+bool spiDevGetTxCount(spi_t *spi, uint16_t *count);
+bool spiDevGetFifoDepth(spi_t *spi, uint16_t *depth);
+bool spiDevClearRxOV(spi_t *spi);
+bool spiDevClearTxOV(spi_t *spi);
+bool spiDevResetRx(spi_t *spi);
+bool spiDevResetTx(spi_t *spi);
+
+bool spiDevGetWordsize(spi_t *spi, uint8_t *size);
+bool spiDevSetWordsize(spi_t *spi, uint8_t size);
+
+bool spiDevGetDevice(spi_t *spi, uint8_t *dev);
+bool spiDevSetDevice(spi_t *spi, uint8_t dev);
+
+bool spiDevGetCSModeForDevice(spi_t *spi, uint8_t dev, bool *mode);
+bool spiDevSetCSModeForDevice(spi_t *spi, uint8_t dev, bool mode);
+bool spiDevGetCSEnableForDevice(spi_t *spi, uint8_t dev, bool *enable);
+bool spiDevSetCSEnableForDevice(spi_t *spi, uint8_t dev, bool enable);
+bool spiDevGetSPIModeForDevice(spi_t *spi, uint8_t dev, bool *spo, bool *sph);
+bool spiDevSetSPIModeForDevice(spi_t *spi, uint8_t dev, bool spo, bool sph);
+
+bool spiDevGetBRD(spi_t *spi, double *brd);
+bool spiDevSetBRD(spi_t *spi, double brd);
+
+bool spiDevGetFrameLength(spi_t *spi, uint16_t *length);
+bool spiDevSetFrameLength(spi_t *spi, uint16_t length);
+
+bool spiDevGetProfileEnable(spi_t *spi, bool *enable);
+bool spiDevSetProfileEnable(spi_t *spi, bool enable);
+bool spiDevGetProfileForDevice(spi_t *spi, uint8_t dev, uint8_t *size, bool *spo, bool *sph, bool *csAuto, double *brd);
+bool spiDevSetProfileForDevice(spi_t *spi, uint8_t dev, uint8_t size, bool spo, bool sph, bool csAuto, double brd);
+
+bool spiDevGetDebug(spi_t *spi, uint16_t *debug);
+
+// The core at SPI_BASE_OFFSET
 bool spiOpen();
+bool spiSync();
+bool spiConfigure(const struct spi_config *config);
+bool spiGetConfig(struct spi_config *config);
 
 bool getStatus(bool *state);
 bool setStatus(bool state);
 
 bool sendData(uint32_t data);
+bool sendTaggedData(uint8_t dev, uint8_t size, uint32_t data);
 bool readData(uint32_t *data);
+bool spiTransfer(const uint32_t *tx, uint32_t *rx, size_t n);
 
 bool getRxStatus(bool *empty, bool *full, bool *ovr);
 bool getTxStatus(bool *empty, bool *full, bool *ovr);
-bool getRxCount(uint8_t *count);
-bool getTxCount(uint8_t *count);
+bool getRxCount(uint16_t *count);
+bool getTxCount(uint16_t *count);
+bool getFifoDepth(uint16_t *depth);
 bool clearRxOV();
 bool clearTxOV();
 bool resetRx();
@@ -60,4 +147,14 @@ bool setSPIModeForDevice(uint8_t dev, bool spo, bool sph);
 bool getBRD(double *brd);
 bool setBRD(double brd);
 
+bool getFrameLength(uint16_t *length);
+bool setFrameLength(uint16_t length);
+
+bool getProfileEnable(bool *enable);
+bool setProfileEnable(bool enable);
+bool getProfileForDevice(uint8_t dev, uint8_t *size, bool *spo, bool *sph, bool *csAuto, double *brd);
+bool setProfileForDevice(uint8_t dev, uint8_t size, bool spo, bool sph, bool csAuto, double brd);
+
+bool getDebug(uint16_t *debug);
+
 #endif
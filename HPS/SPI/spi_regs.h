@@ -25,8 +25,39 @@
 #define OFS_STATUS           1
 #define OFS_CONTROL          2
 #define OFS_BRD              3
-
-#define SPAN_IN_BYTES 32
+#define OFS_INT_ENABLE       4
+#define OFS_INT_STATUS       5
+#define OFS_WATERMARK        6
+#define OFS_FIFO_LEVEL       7
+#define OFS_DMA_SRC          8
+#define OFS_DMA_DST          9
+#define OFS_DMA_COUNT        10
+#define OFS_DMA_CONTROL      11
+#define OFS_FRAME_LENGTH     12
+#define OFS_TAGGED_DATA      13
+#define OFS_PROFILE          16  // 16-19, one per chip select
+
+#define INT_TX_LOW           0x1
+#define INT_RX_HIGH          0x2
+#define INT_EOF              0x4
+#define INT_DMA              0x8
+
+#define DMA_GO               0x00000001
+#define DMA_BUSY             0x00000001  // read
+#define DMA_TX               0x00000002
+#define DMA_RX               0x00000004
+#define DMA_DONE             0x00010000
+#define DMA_PRESENT          0x80000000
+
+#define PROFILE_ENABLE       0x01000000  // CONTROL bit selecting per-CS profiles
+
+// Tagged Tx word: [31:30] CS, [29:25] word size - 1, [24:0] data
+#define TAG(cs, size)        ((((uint32_t)(cs) & 0x3) << 30) | ((((uint32_t)(size) - 1) & 0x1F) << 25))
+#define TAG_DATA_MASK        0x01FFFFFF
+
+#define SPAN_IN_BYTES 128
+
+#define SPI_IRQ 81
 
 #endif
 
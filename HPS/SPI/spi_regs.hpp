@@ -0,0 +1,177 @@
+// SPI IP
+// SPI IP Register Fields
+// CSE4356-SoC | Fall 2021 | Term Project
+// Deborah Jahaj and Nathan Fusselman
+
+//=============================================================================
+// Hardware Target
+//=============================================================================
+
+// Target Platform: DE1-SoC Board
+
+// Hardware configuration:
+// SPI IP core connected to light-weight Avalon bus
+
+// The registers of spi_regs.h with their fields as ../mmio_reg.hpp types,
+// following the register map in ../../FPGA/spi_dev.v. A new configuration
+// of the core is one CONTROL store, e.g.
+//   Control::update(base, shadow, control::WordSize::of(8 - 1)
+//                   | control::CsSelect::of(1) | control::Mode::at(1, modeBits(3))
+//                   | control::Enable::of(1));
+// MODEn is {SPO, SPO ^ SPH}: bit 17 + 2n is the clock polarity and bit
+// 16 + 2n selects the sampling edge relative to it, so modeBits() converts
+// a Linux SPI mode number (SPO << 1 | SPH). The profiles use the same
+// encoding in [6:5].
+
+//=============================================================================
+
+#ifndef SPI_REGS_HPP_
+#define SPI_REGS_HPP_
+
+#include <stdint.h>
+#include "../mmio_reg.hpp"
+
+namespace spi_regs
+{
+
+using mmio::Register;
+using mmio::Field;
+using mmio::FieldArray;
+
+//=============================================================================
+// Registers
+//=============================================================================
+
+struct Core;                 // tag of this core
+
+// MODEn value for SPI mode (SPO << 1) | SPH
+constexpr uint32_t modeBits(unsigned mode)
+{
+    return (mode & 0x2) | (((mode >> 1) ^ mode) & 0x1);
+}
+
+typedef Register<Core, 0>  Data;
+typedef Register<Core, 1>  Status;
+typedef Register<Core, 2>  Control;
+typedef Register<Core, 3>  Brd;
+typedef Register<Core, 4>  IntEnable;
+typedef Register<Core, 5>  IntStatus;
+typedef Register<Core, 6>  Watermark;
+typedef Register<Core, 7>  FifoLevel;
+typedef Register<Core, 8>  DmaSrc;
+typedef Register<Core, 9>  DmaDst;
+typedef Register<Core, 10> DmaCount;
+typedef Register<Core, 11> DmaControl;
+typedef Register<Core, 12> FrameLength;
+typedef Register<Core, 13> TaggedData;
+template <unsigned Dev>
+using Profile = Register<Core, 16 + Dev>;
+
+//=============================================================================
+// Fields
+//=============================================================================
+
+// Overflow bits are write 1 to clear, the FIFO resets are write only and
+// the counts saturate at 15 (FifoLevel has the full counts)
+namespace status
+{
+    typedef Field<Status, 0, 1>   RxOverflow;
+    typedef Field<Status, 1, 1>   RxFull;
+    typedef Field<Status, 2, 1>   RxEmpty;
+    typedef Field<Status, 3, 1>   TxOverflow;
+    typedef Field<Status, 4, 1>   TxFull;
+    typedef Field<Status, 5, 1>   TxEmpty;
+    typedef Field<Status, 6, 1>   RxReset;
+    typedef Field<Status, 7, 1>   TxReset;
+    typedef Field<Status, 8, 4>   RxCount;
+    typedef Field<Status, 12, 4>  TxCount;
+    typedef Field<Status, 16, 16> Debug;
+}
+
+namespace control
+{
+    typedef Field<Control, 0, 5>            WordSize;    // size - 1
+    typedef FieldArray<Control, 5, 1, 1, 4> CsAuto;
+    typedef FieldArray<Control, 9, 1, 1, 4> CsEnable;
+    typedef Field<Control, 13, 2>           CsSelect;
+    typedef Field<Control, 15, 1>           Enable;
+    typedef FieldArray<Control, 16, 2, 2, 4> Mode;       // modeBits()
+    typedef FieldArray<Control, 16, 1, 2, 4> Edge;       // SPO ^ SPH
+    typedef FieldArray<Control, 17, 1, 2, 4> Spo;
+    typedef Field<Control, 24, 1>           ProfileEnable;
+}
+
+// Baud rate divisor with 6 fractional bits
+namespace brd
+{
+    typedef Field<Brd, 0, 6>  Fraction;
+    typedef Field<Brd, 6, 26> Integer;
+    typedef Field<Brd, 0, 32> Divisor;
+}
+
+// Same bits in IntEnable and IntStatus (write 1 to clear)
+namespace interrupt
+{
+    typedef Field<IntEnable, 0, 1> TxLowEnable;
+    typedef Field<IntEnable, 1, 1> RxHighEnable;
+    typedef Field<IntEnable, 2, 1> EofEnable;
+    typedef Field<IntEnable, 3, 1> DmaEnable;
+    typedef Field<IntStatus, 0, 1> TxLow;
+    typedef Field<IntStatus, 1, 1> RxHigh;
+    typedef Field<IntStatus, 2, 1> Eof;
+    typedef Field<IntStatus, 3, 1> Dma;
+}
+
+namespace watermark
+{
+    typedef Field<Watermark, 0, 16>  TxLow;
+    typedef Field<Watermark, 16, 16> RxHigh;
+}
+
+namespace fifo_level
+{
+    typedef Field<FifoLevel, 0, 12>  TxCount;
+    typedef Field<FifoLevel, 12, 4>  TxDepthLog2;
+    typedef Field<FifoLevel, 16, 12> RxCount;
+    typedef Field<FifoLevel, 28, 4>  RxDepthLog2;
+}
+
+// Go, Tx, Rx, CsSelect and WordSize are written; Busy, Done (write 1 to
+// clear) and Present are read
+namespace dma_control
+{
+    typedef Field<DmaControl, 0, 1>  Go;
+    typedef Field<DmaControl, 0, 1>  Busy;
+    typedef Field<DmaControl, 1, 1>  Tx;
+    typedef Field<DmaControl, 2, 1>  Rx;
+    typedef Field<DmaControl, 3, 2>  CsSelect;
+    typedef Field<DmaControl, 5, 5>  WordSize;   // size - 1
+    typedef Field<DmaControl, 16, 1> Done;
+    typedef Field<DmaControl, 31, 1> Present;
+}
+
+namespace frame_length
+{
+    typedef Field<FrameLength, 0, 16> Length;
+}
+
+namespace tagged_data
+{
+    typedef Field<TaggedData, 0, 25> Data;
+    typedef Field<TaggedData, 25, 5> WordSize;   // size - 1
+    typedef Field<TaggedData, 30, 2> CsSelect;
+}
+
+namespace profile
+{
+    template <unsigned Dev> using WordSize = Field<Profile<Dev>, 0, 5>;   // size - 1
+    template <unsigned Dev> using Mode     = Field<Profile<Dev>, 5, 2>;   // modeBits()
+    template <unsigned Dev> using Edge     = Field<Profile<Dev>, 5, 1>;   // SPO ^ SPH
+    template <unsigned Dev> using Spo      = Field<Profile<Dev>, 6, 1>;
+    template <unsigned Dev> using CsAuto   = Field<Profile<Dev>, 7, 1>;
+    template <unsigned Dev> using Brd      = Field<Profile<Dev>, 8, 24>;  // divisor as in Brd
+}
+
+}
+
+#endif
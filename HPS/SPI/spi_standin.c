@@ -0,0 +1,263 @@
+// SPI IP
+// SPI IP Software Register Model
+// CSE4356-SoC | Fall 2021 | Term Project
+// Deborah Jahaj and Nathan Fusselman
+
+//=============================================================================
+// Hardware Target
+//=============================================================================
+
+// Target Platform: Any Linux host
+
+// Models the register interface of spi_dev.v closely enough for spi_ip.c:
+//   16 word Tx and Rx FIFOs with the STATUS and FIFO_LEVEL encodings
+//   Overflow flags and FIFO resets through STATUS writes
+//   CONTROL, BRD, profiles and tagged words selecting size, CS and rate
+//   MOSI looped back to MISO, or an attached device model
+//   Chip select framing from CS mode, CS_ENABLE and FRAME_LENGTH
+// Each word occupies the line for its size in SCLK periods plus one period
+// of CS setup and hold in auto mode (one idle period in manual mode), timed
+// against CLOCK_MONOTONIC so throughput reflects the configured baud rate.
+// DMA and interrupts are not modeled.
+
+//=============================================================================
+
+#include <stdint.h>          // C99 integer types -- uint32_t
+#include <stdbool.h>         // bool
+#include <string.h>          // memset
+#include <time.h>            // clock_gettime
+#include "spi_regs.h"        // registers
+#include "spi_standin.h"     // software register model
+
+#define SYSTEM_CLOCK_NS 20   // 50 MHz
+#define FIFO_DEPTH      16
+#define FIFO_LOG2_DEPTH 4
+#define REG_COUNT       20
+
+//=============================================================================
+// Global variables
+//=============================================================================
+
+uint32_t standinRegs[REG_COUNT];
+
+struct standin_fifo
+{
+    uint32_t data[FIFO_DEPTH];
+    uint8_t size[FIFO_DEPTH];
+    uint8_t cs[FIFO_DEPTH];
+    uint8_t head;
+    uint8_t count;
+};
+
+struct standin_fifo txFifo;
+struct standin_fifo rxFifo;
+bool rxOverflow = false;
+bool txOverflow = false;
+
+// Word currently in the shift register and the time its last bit is done
+bool shifting = false;
+uint32_t shiftData = 0;
+uint8_t shiftSize = 0;
+uint8_t shiftCs = 0;
+uint64_t shiftDone = 0;
+
+// Words sent under the current auto chip select assertion
+uint16_t frameCount = 0;
+
+const struct standin_device *device = NULL;
+
+//=============================================================================
+// Subroutines
+//=============================================================================
+
+static uint64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static bool fifoPush(struct standin_fifo *fifo, uint32_t data, uint8_t size, uint8_t cs)
+{
+    if (fifo->count == FIFO_DEPTH) return false;
+    uint8_t tail = (fifo->head + fifo->count) % FIFO_DEPTH;
+    fifo->data[tail] = data;
+    fifo->size[tail] = size;
+    fifo->cs[tail] = cs;
+    fifo->count++;
+    return true;
+}
+
+static void fifoPop(struct standin_fifo *fifo, uint32_t *data, uint8_t *size, uint8_t *cs)
+{
+    *data = fifo->data[fifo->head];
+    *size = fifo->size[fifo->head];
+    *cs = fifo->cs[fifo->head];
+    fifo->head = (fifo->head + 1) % FIFO_DEPTH;
+    fifo->count--;
+}
+
+static bool csAutoFor(uint8_t cs)
+{
+    uint32_t control = standinRegs[OFS_CONTROL];
+    if (control & PROFILE_ENABLE)
+        return (standinRegs[OFS_PROFILE+cs] >> 7) & 0x1;
+    return (control >> (5 + cs)) & 0x1;
+}
+
+// Line time of one word on a chip select, using its profile when enabled
+static uint64_t wordTime(uint8_t size, uint8_t cs)
+{
+    uint32_t brd = standinRegs[OFS_BRD];
+    if (standinRegs[OFS_CONTROL] & PROFILE_ENABLE)
+        brd = standinRegs[OFS_PROFILE+cs] >> 8;
+    uint64_t periodNs = ((uint64_t)brd * SYSTEM_CLOCK_NS) >> 6;
+    if (periodNs == 0) periodNs = SYSTEM_CLOCK_NS;
+    return (size + (csAutoFor(cs) ? 2 : 1)) * periodNs;
+}
+
+static void startNext(uint64_t start)
+{
+    fifoPop(&txFifo, &shiftData, &shiftSize, &shiftCs);
+    shiftDone = start + wordTime(shiftSize, shiftCs);
+    shifting = true;
+}
+
+// Word clocked in while shiftData was clocked out; an auto chip select
+// drops after every word, or every FRAME_LENGTH words when set above 1
+static uint32_t finishWord()
+{
+    uint32_t mask = (shiftSize == 32) ? 0xFFFFFFFF : ((1u << shiftSize) - 1);
+    bool csAuto = csAutoFor(shiftCs);
+    uint32_t rx;
+
+    if (device == NULL)
+        return shiftData & mask;
+    if (!csAuto && !(standinRegs[OFS_CONTROL] & (1 << (9 + shiftCs))))
+        return 0;
+    rx = device->transfer(shiftCs, shiftSize, shiftData & mask) & mask;
+    if (csAuto && ++frameCount >= (standinRegs[OFS_FRAME_LENGTH] & 0xFFFF))
+    {
+        frameCount = 0;
+        device->deselect(shiftCs);
+    }
+    return rx;
+}
+
+// Retires every word whose last bit has been clocked by now, back to back
+static void update()
+{
+    uint64_t now = nowNs();
+    bool enabled = standinRegs[OFS_CONTROL] & (1 << 15);
+    while (shifting && shiftDone <= now)
+    {
+        if (!fifoPush(&rxFifo, finishWord(), shiftSize, 0))
+            rxOverflow = true;
+        shifting = false;
+        if (enabled && txFifo.count > 0)
+            startNext(shiftDone);
+    }
+    if (!shifting && enabled && txFifo.count > 0)
+        startNext(now);
+}
+
+static uint32_t composeStatus()
+{
+    return (rxOverflow << 0) | ((rxFifo.count == FIFO_DEPTH) << 1) | ((rxFifo.count == 0) << 2)
+         | (txOverflow << 3) | ((txFifo.count == FIFO_DEPTH) << 4) | ((txFifo.count == 0) << 5)
+         | ((rxFifo.count & 0xF) << 8) | ((txFifo.count & 0xF) << 12);
+}
+
+static void queueWord(uint32_t data, uint8_t size, uint8_t cs)
+{
+    if (!fifoPush(&txFifo, data, size, cs))
+        txOverflow = true;
+}
+
+void standinReset()
+{
+    memset(standinRegs, 0, sizeof(standinRegs));
+    memset(&txFifo, 0, sizeof(txFifo));
+    memset(&rxFifo, 0, sizeof(rxFifo));
+    standinRegs[OFS_CONTROL] = 0x000081FF;  // 32 bits, CS auto, enabled
+    standinRegs[OFS_BRD] = 0x00000280;      // 5MHz
+    standinRegs[OFS_PROFILE+0] = 0x0002809F;
+    standinRegs[OFS_PROFILE+1] = 0x0002809F;
+    standinRegs[OFS_PROFILE+2] = 0x0002809F;
+    standinRegs[OFS_PROFILE+3] = 0x0002809F;
+    rxOverflow = false;
+    txOverflow = false;
+    shifting = false;
+    frameCount = 0;
+}
+
+void standinAttach(const struct standin_device *model)
+{
+    device = model;
+}
+
+uint32_t standinRead(uint8_t ofs)
+{
+    uint32_t data = 0;
+    uint8_t size, cs;
+    update();
+    switch (ofs)
+    {
+        case OFS_DATA:
+            if (rxFifo.count > 0) fifoPop(&rxFifo, &data, &size, &cs);
+            break;
+        case OFS_STATUS:
+            data = composeStatus();
+            break;
+        case OFS_FIFO_LEVEL:
+            data = txFifo.count | (FIFO_LOG2_DEPTH << 12)
+                 | (rxFifo.count << 16) | (FIFO_LOG2_DEPTH << 28);
+            break;
+        case OFS_DMA_CONTROL:
+        case OFS_INT_STATUS:
+            break;
+        default:
+            if (ofs < REG_COUNT) data = standinRegs[ofs];
+            break;
+    }
+    return data;
+}
+
+void standinWrite(uint8_t ofs, uint32_t data)
+{
+    uint32_t control = standinRegs[OFS_CONTROL];
+    uint8_t cs = (control >> 13) & 0x3;
+    update();
+    switch (ofs)
+    {
+        case OFS_DATA:
+            if (control & PROFILE_ENABLE)
+                queueWord(data, (standinRegs[OFS_PROFILE+cs] & 0x1F) + 1, cs);
+            else
+                queueWord(data, (control & 0x1F) + 1, cs);
+            break;
+        case OFS_TAGGED_DATA:
+            queueWord(data & TAG_DATA_MASK, ((data >> 25) & 0x1F) + 1, data >> 30);
+            break;
+        case OFS_STATUS:
+            if (data & (1 << 0)) rxOverflow = false;
+            if (data & (1 << 3)) txOverflow = false;
+            if (data & (1 << 6)) rxFifo.count = 0;
+            if (data & (1 << 7)) txFifo.count = 0;
+            break;
+        case OFS_CONTROL:
+            standinRegs[OFS_CONTROL] = data;
+            // A manual chip select being released ends the device's frame
+            for (cs = 0; cs < 4; cs++)
+                if (device && (control & ~data & (1 << (9 + cs))))
+                    device->deselect(cs);
+            break;
+        case OFS_FIFO_LEVEL:
+        case OFS_INT_STATUS:
+            break;
+        default:
+            if (ofs < REG_COUNT) standinRegs[ofs] = data;
+            break;
+    }
+    update();
+}
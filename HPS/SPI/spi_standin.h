@@ -0,0 +1,46 @@
+// SPI IP
+// SPI IP Software Register Model
+// CSE4356-SoC | Fall 2021 | Term Project
+// Deborah Jahaj and Nathan Fusselman
+
+//=============================================================================
+// Hardware Target
+//=============================================================================
+
+// Target Platform: Any Linux host
+
+// Stands in for the SPI IP core when spi_ip.c is built with SPI_STANDIN,
+// so spi_bench and the CLI run without a DE1-SoC. MOSI is looped back to
+// MISO unless a device model is attached, and words complete at the rate
+// set by BRD and the word size.
+
+//=============================================================================
+
+#ifndef SPI_STANDIN_H_
+#define SPI_STANDIN_H_
+
+#include <stdint.h>
+
+//=============================================================================
+// Device model
+//=============================================================================
+
+// Slave on the far end of the bus (e.g. the MCP23S08 in the virtual
+// DE1-SoC): transfer is called as each word finishes with the word clocked
+// out and returns the word clocked in, deselect when the chip select drops
+struct standin_device
+{
+    uint32_t (*transfer)(uint8_t cs, uint8_t size, uint32_t data);
+    void (*deselect)(uint8_t cs);
+};
+
+//=============================================================================
+// Subroutines
+//=============================================================================
+
+void standinReset();
+void standinAttach(const struct standin_device *device);
+uint32_t standinRead(uint8_t ofs);
+void standinWrite(uint8_t ofs, uint32_t data);
+
+#endif
@@ -0,0 +1,201 @@
+// Virtual DE1-SoC
+// Virtual DE1-SoC Simulator
+// CSE4356-SoC | Fall 2021 | Term Project
+// Deborah Jahaj and Nathan Fusselman
+
+//=============================================================================
+// Hardware Target
+//=============================================================================
+
+// Target Platform: Any Linux host
+
+// Serves the virtual light-weight bus mailbox (virtual_bus.h) for the IP
+// libraries built with VIRTUAL_DE1SOC:
+//   GPIO IP at GPIO_BASE_OFFSET (sim_gpio.c)
+//   QE IP at QE_BASE_OFFSET (sim_qe.c)
+//   SPI IP at SPI_BASE_OFFSET (../SPI/spi_standin.c) with MCP23S08
+//   expanders attached (sim_mcp23s08.c)
+// Accesses outside the cores read as 0 and writes are ignored.
+
+//=============================================================================
+// Device includes, defines, and assembler directives
+//=============================================================================
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "../address_map.h"
+#include "../SPI/spi_standin.h"
+#include "virtual_bus.h"
+#include "sim_gpio.h"
+#include "sim_qe.h"
+#include "sim_mcp23s08.h"
+
+// Aperatures of the cores (SPAN_IN_BYTES of gpio_regs.h and spi_regs.h,
+// QE_SPAN_IN_BYTES of qe_regs.h)
+#define GPIO_SPAN            32
+#define QE_SPAN              32
+#define SPI_SPAN             128
+
+#define SPINS_BEFORE_YIELD   1000
+#define SPINS_BEFORE_SLEEP   100000
+#define IDLE_SLEEP_US        50
+
+//=============================================================================
+// Global variables
+//=============================================================================
+
+volatile sig_atomic_t running = true;
+bool verbose = false;
+
+//=============================================================================
+// Subroutines
+//=============================================================================
+
+static void stop(int signal)
+{
+    running = false;
+}
+
+static bool inside(uint32_t address, uint32_t base, uint32_t span)
+{
+    return address >= base && address < base + span;
+}
+
+static uint32_t busRead(uint32_t address)
+{
+    if (inside(address, GPIO_BASE_OFFSET, GPIO_SPAN))
+        return gpioSimRead((address - GPIO_BASE_OFFSET) / 4);
+    if (inside(address, QE_BASE_OFFSET, QE_SPAN))
+        return qeSimRead((address - QE_BASE_OFFSET) / 4);
+    if (inside(address, SPI_BASE_OFFSET, SPI_SPAN))
+        return standinRead((address - SPI_BASE_OFFSET) / 4);
+    return 0;
+}
+
+static void busWrite(uint32_t address, uint32_t data)
+{
+    if (inside(address, GPIO_BASE_OFFSET, GPIO_SPAN))
+        gpioSimWrite((address - GPIO_BASE_OFFSET) / 4, data);
+    else if (inside(address, QE_BASE_OFFSET, QE_SPAN))
+        qeSimWrite((address - QE_BASE_OFFSET) / 4, data);
+    else if (inside(address, SPI_BASE_OFFSET, SPI_SPAN))
+        standinWrite((address - SPI_BASE_OFFSET) / 4, data);
+}
+
+static void serve(struct vbus_mailbox *mailbox)
+{
+    uint32_t request, spins = 0;
+    while (running)
+    {
+        request = __atomic_load_n(&mailbox->request, __ATOMIC_ACQUIRE);
+        if (request == mailbox->response)
+        {
+            // Spin while clients are busy (yielding in case they share the
+            // CPU), back off once idle
+            if (++spins > SPINS_BEFORE_SLEEP)
+                usleep(IDLE_SLEEP_US);
+            else if (spins % SPINS_BEFORE_YIELD == 0)
+                sched_yield();
+            continue;
+        }
+        spins = 0;
+        if (mailbox->write)
+            busWrite(mailbox->address, mailbox->data);
+        else
+            mailbox->data = busRead(mailbox->address);
+        if (verbose)
+            printf("%s 0x%05X 0x%08X\n", mailbox->write ? "W" : "R",
+                   mailbox->address, mailbox->data);
+        mailbox->accesses++;
+        __atomic_store_n(&mailbox->response, request, __ATOMIC_RELEASE);
+    }
+}
+
+//=============================================================================
+// Main
+//=============================================================================
+
+int main(int argc, char* argv[])
+{
+    const char *name = getenv(VBUS_NAME_ENV);
+    uint16_t chips = 0x1;
+    uint8_t mcpInputs = 0;
+    uint32_t walkMs = 0;
+    uint32_t gpioInputs = 0;
+    int32_t qeRate = 1000;
+    int i;
+
+    if (name == NULL) name = VBUS_DEFAULT_NAME;
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            chips = (uint16_t)strtol(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            mcpInputs = (uint8_t)strtol(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            walkMs = (uint32_t)strtol(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc) {
+            gpioInputs = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-q") == 0 && i + 1 < argc) {
+            qeRate = (int32_t)strtol(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-v") == 0) {
+            verbose = true;
+        } else {
+            printf("  usage:\n");
+            printf("  de1soc_sim [-c chips] [-m inputs] [-w ms] [-g inputs] [-q rate] [-v]\n");
+            printf("  \n");
+            printf("  -c chips     MCP23S08s present, bit CS*4+A1:A0 (default 0x1)\n");
+            printf("  -m inputs    Level on the MCP23S08 pins (default 0x00)\n");
+            printf("  -w ms        Walk a one across the MCP23S08 pins every ms\n");
+            printf("  -g inputs    Level on undriven GPIO_1 pins (default 0)\n");
+            printf("  -q rate      QE counts per second (default 1000)\n");
+            printf("  -v           Print every access\n");
+            printf("  \n");
+            printf("  Clients find the region through %s (default %s)\n",
+                   VBUS_NAME_ENV, VBUS_DEFAULT_NAME);
+            return (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    int file = shm_open(name, O_CREAT | O_RDWR, 0666);
+    if (file < 0 || ftruncate(file, sizeof(struct vbus_mailbox)) < 0) {
+        perror("  shm_open");
+        return EXIT_FAILURE;
+    }
+    struct vbus_mailbox *mailbox = mmap(NULL, sizeof(struct vbus_mailbox),
+                                        PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    close(file);
+    if (mailbox == MAP_FAILED) {
+        perror("  mmap");
+        shm_unlink(name);
+        return EXIT_FAILURE;
+    }
+
+    standinReset();
+    mcpInit(chips, mcpInputs, walkMs);
+    mcpAttach();
+    gpioSimInit(gpioInputs);
+    qeSimInit(qeRate);
+
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+    memset(mailbox, 0, sizeof(struct vbus_mailbox));
+    __atomic_store_n(&mailbox->magic, VBUS_MAGIC, __ATOMIC_RELEASE);
+    printf("  Serving virtual DE1-SoC on %s\n", name);
+    fflush(stdout);
+
+    serve(mailbox);
+
+    printf("  %llu accesses\n", (unsigned long long)mailbox->accesses);
+    mailbox->magic = 0;
+    munmap(mailbox, sizeof(struct vbus_mailbox));
+    shm_unlink(name);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,96 @@
+// Virtual DE1-SoC
+// GPIO IP Model
+// CSE4356-SoC | Fall 2021 | Term Project
+// Deborah Jahaj and Nathan Fusselman
+
+//=============================================================================
+// Hardware Target
+//=============================================================================
+
+// Target Platform: Any Linux host
+
+// Follows gpio.v:
+//   OUT LATCH ODR   PIN
+//    0    x    x    input
+//    1    0    x     0
+//    1    1    0     1
+//    1    1    1    input (open drain released)
+//   Edge interrupts against the pin level at the previous access, level
+//   interrupts while the level holds, cleared by writing INT_STATUS_CLEAR
+// The IRQ line itself is not delivered anywhere.
+
+//=============================================================================
+
+#include <stdint.h>                 // C99 integer types -- uint32_t
+#include <stdbool.h>                // bool
+#include "../GPIO/gpio_regs.h"      // registers
+#include "sim_mcp23s08.h"           // INT line on GPIO_1[31]
+#include "sim_gpio.h"               // gpio model
+
+#define INT_GPIO_MASK (1u << 31)
+
+//=============================================================================
+// Global variables
+//=============================================================================
+
+uint32_t gpioRegs[OFS_INT_STATUS_CLEAR + 1];
+uint32_t externalInputs = 0;
+uint32_t lastPins = 0;
+
+//=============================================================================
+// Subroutines
+//=============================================================================
+
+static uint32_t pinLevels()
+{
+    uint32_t latch = gpioRegs[OFS_DATA];
+    uint32_t out = gpioRegs[OFS_OUT];
+    uint32_t od = gpioRegs[OFS_OD];
+    uint32_t inputs = externalInputs & ~INT_GPIO_MASK;
+    if (mcpIntLevel()) inputs |= INT_GPIO_MASK;
+    uint32_t released = ~out | (latch & od);
+    return (inputs & released) | (latch & ~released);
+}
+
+static void updateInterrupts()
+{
+    uint32_t pins = pinLevels();
+    uint32_t enable = gpioRegs[OFS_INT_ENABLE];
+    uint32_t positive = gpioRegs[OFS_INT_POSITIVE];
+    uint32_t negative = gpioRegs[OFS_INT_NEGATIVE];
+    uint32_t edge = gpioRegs[OFS_INT_EDGE_MODE];
+    uint32_t rising = pins & ~lastPins;
+    uint32_t falling = ~pins & lastPins;
+    gpioRegs[OFS_INT_STATUS_CLEAR] |= enable & ((edge & ((positive & rising) | (negative & falling)))
+                                             | (~edge & ((positive & pins) | (negative & ~pins))));
+    lastPins = pins;
+}
+
+void gpioSimInit(uint32_t inputs)
+{
+    uint8_t i;
+    for (i = 0; i <= OFS_INT_STATUS_CLEAR; i++)
+        gpioRegs[i] = 0;
+    externalInputs = inputs;
+    lastPins = pinLevels();
+}
+
+uint32_t gpioSimRead(uint8_t ofs)
+{
+    updateInterrupts();
+    if (ofs == OFS_DATA)
+        return pinLevels();
+    if (ofs <= OFS_INT_STATUS_CLEAR)
+        return gpioRegs[ofs];
+    return 0;
+}
+
+void gpioSimWrite(uint8_t ofs, uint32_t data)
+{
+    updateInterrupts();
+    if (ofs == OFS_INT_STATUS_CLEAR)
+        gpioRegs[ofs] &= ~data;
+    else if (ofs < OFS_INT_STATUS_CLEAR)
+        gpioRegs[ofs] = data;
+    updateInterrupts();
+}
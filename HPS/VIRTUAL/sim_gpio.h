@@ -0,0 +1,31 @@
+// Virtual DE1-SoC
+// GPIO IP Model
+// CSE4356-SoC | Fall 2021 | Term Project
+// Deborah Jahaj and Nathan Fusselman
+
+//=============================================================================
+// Hardware Target
+//=============================================================================
+
+// Target Platform: Any Linux host
+
+// GPIO IP core (gpio.v) driving GPIO_1[31-0] of the virtual DE1-SoC
+
+//=============================================================================
+
+#ifndef SIM_GPIO_H_
+#define SIM_GPIO_H_
+
+#include <stdint.h>
+
+//=============================================================================
+// Subroutines
+//=============================================================================
+
+// inputs: level seen on pins that are not driven (GPIO_1[31] follows the
+// MCP23S08 INT line instead)
+void gpioSimInit(uint32_t inputs);
+uint32_t gpioSimRead(uint8_t ofs);
+void gpioSimWrite(uint8_t ofs, uint32_t data);
+
+#endif
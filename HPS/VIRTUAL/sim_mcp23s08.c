@@ -0,0 +1,225 @@
+// Virtual DE1-SoC
+// MCP23S08 Model
+// CSE4356-SoC | Fall 2021 | Term Project
+// Deborah Jahaj and Nathan Fusselman
+
+//=============================================================================
+// Hardware Target
+//=============================================================================
+
+// Target Platform: Any Linux host
+
+// Byte-level model of the MCP23S08 SPI protocol:
+//   Opcode 0100 A1 A0 R/W, register address, then data bytes with the
+//   address advancing (wrapping after OLAT) unless IOCON.SEQOP is set
+//   A1:A0 compared only once IOCON.HAEN is set, so a write with HAEN clear
+//   reaches every chip on the chip select (as the drivers rely on)
+//   GPIO reads apply IPOL to input pins and return OLAT for outputs;
+//   GPIO writes go to OLAT
+//   Interrupt on change against the previous value or DEFVAL, captured in
+//   INTF/INTCAP and cleared by reading GPIO or INTCAP
+//   INT output honoring IOCON.ODR and IOCON.INTPOL
+// Words of any multiple of 8 bits are split into bytes MSB first, so both
+// the 24-bit single word transactions and 8-bit bursts work.
+
+//=============================================================================
+
+#include <stdint.h>                         // C99 integer types -- uint32_t
+#include <stdbool.h>                        // bool
+#include <string.h>                         // memset
+#include <time.h>                           // clock_gettime
+#include "../SPI/spi_standin.h"             // SPI core model
+#include "../SPI/MCP23S08/gpio_expander_regs.h" // registers
+#include "sim_mcp23s08.h"                   // expander model
+
+#define MAX_CHIPS 16
+#define REG(reg)  ((reg) >> 8)
+
+//=============================================================================
+// Global variables
+//=============================================================================
+
+struct mcp_chip
+{
+    bool present;
+    uint8_t regs[REG_COUNT];
+    uint8_t previous;                       // input level at the last check
+};
+
+// Frame state of each chip select: bytes seen since it was asserted
+struct mcp_frame
+{
+    uint8_t index;
+    uint8_t opcode;
+    uint8_t reg;
+};
+
+struct mcp_chip chips[MAX_CHIPS];
+struct mcp_frame frames[4];
+
+uint8_t inputBase = 0;
+uint32_t walkPeriodMs = 0;
+struct timespec walkStart;
+
+//=============================================================================
+// Subroutines
+//=============================================================================
+
+static uint8_t inputLevel()
+{
+    struct timespec now;
+    uint64_t elapsedMs;
+    if (walkPeriodMs == 0) return inputBase;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    elapsedMs = (now.tv_sec - walkStart.tv_sec) * 1000
+              + (now.tv_nsec - walkStart.tv_nsec) / 1000000;
+    return inputBase ^ (1 << ((elapsedMs / walkPeriodMs) % 8));
+}
+
+static uint8_t portValue(struct mcp_chip *chip, uint8_t inputs)
+{
+    uint8_t iodir = chip->regs[REG(IODIR)];
+    return ((inputs ^ chip->regs[REG(IPOL)]) & iodir) | (chip->regs[REG(OLAT)] & ~iodir);
+}
+
+// Latches pins that changed (or differ from DEFVAL) into INTF/INTCAP;
+// INTCAP keeps the port value of the first change until it is cleared
+static void checkInterrupts(struct mcp_chip *chip)
+{
+    uint8_t inputs = inputLevel();
+    uint8_t enabled = chip->regs[REG(GPINTEN)] & chip->regs[REG(IODIR)];
+    uint8_t intcon = chip->regs[REG(INTCON)];
+    uint8_t flagged = enabled & ((intcon & (inputs ^ chip->regs[REG(DEFVAL)]))
+                               | (~intcon & (inputs ^ chip->previous)));
+    chip->previous = inputs;
+    if (flagged == 0) return;
+    if (chip->regs[REG(INTF)] == 0)
+        chip->regs[REG(INTCAP)] = portValue(chip, inputs);
+    chip->regs[REG(INTF)] |= flagged;
+}
+
+static uint8_t readRegister(struct mcp_chip *chip, uint8_t reg)
+{
+    uint8_t data;
+    checkInterrupts(chip);
+    if (reg == REG(GPIO))
+        data = portValue(chip, inputLevel());
+    else
+        data = chip->regs[reg];
+    if (reg == REG(GPIO) || reg == REG(INTCAP))
+    {
+        chip->regs[REG(INTF)] = 0;
+        checkInterrupts(chip);
+    }
+    return data;
+}
+
+static void writeRegister(struct mcp_chip *chip, uint8_t reg, uint8_t data)
+{
+    checkInterrupts(chip);
+    if (reg == REG(INTF) || reg == REG(INTCAP)) return;
+    if (reg == REG(GPIO)) reg = REG(OLAT);
+    chip->regs[reg] = data;
+}
+
+static void resetChip(struct mcp_chip *chip)
+{
+    memset(chip->regs, 0, sizeof(chip->regs));
+    chip->regs[REG(IODIR)] = 0xFF;
+    chip->previous = inputLevel();
+}
+
+// One byte on a chip select: every chip it addresses sees it, and the
+// first one reading drives MISO
+static uint8_t transferByte(uint8_t cs, uint8_t tx)
+{
+    struct mcp_frame *frame = &frames[cs];
+    uint8_t addr, rx = 0;
+    bool driven = false, sequential = true;
+
+    if (frame->index == 0)
+        frame->opcode = tx;
+    else if (frame->index == 1)
+        frame->reg = tx;
+    else if ((frame->opcode & 0xF0) == 0x40 && frame->reg < REG_COUNT)
+    {
+        for (addr = 0; addr < 4; addr++)
+        {
+            struct mcp_chip *chip = &chips[cs * 4 + addr];
+            if (!chip->present) continue;
+            if ((chip->regs[REG(IOCON)] & IOCON_HAEN) && ((frame->opcode >> 1) & 0x3) != addr)
+                continue;
+            if (chip->regs[REG(IOCON)] & IOCON_SEQOP)
+                sequential = false;
+            if (frame->opcode & 0x01)
+            {
+                uint8_t data = readRegister(chip, frame->reg);
+                if (!driven) rx = data;
+                driven = true;
+            }
+            else
+                writeRegister(chip, frame->reg, tx);
+        }
+        if (sequential)
+            frame->reg = (frame->reg + 1) % REG_COUNT;
+    }
+    if (frame->index < 2) frame->index++;
+    return rx;
+}
+
+static uint32_t transfer(uint8_t cs, uint8_t size, uint32_t data)
+{
+    uint32_t rx = 0;
+    int8_t shift;
+    if (size % 8 != 0) return 0;
+    for (shift = size - 8; shift >= 0; shift -= 8)
+        rx = (rx << 8) | transferByte(cs, (data >> shift) & 0xFF);
+    return rx;
+}
+
+static void deselect(uint8_t cs)
+{
+    frames[cs].index = 0;
+}
+
+const struct standin_device mcpDevice = {transfer, deselect};
+
+void mcpInit(uint16_t present, uint8_t inputs, uint32_t walkMs)
+{
+    uint8_t i;
+    inputBase = inputs;
+    walkPeriodMs = walkMs;
+    clock_gettime(CLOCK_MONOTONIC, &walkStart);
+    memset(frames, 0, sizeof(frames));
+    for (i = 0; i < MAX_CHIPS; i++)
+    {
+        chips[i].present = (present >> i) & 1;
+        resetChip(&chips[i]);
+    }
+}
+
+void mcpAttach()
+{
+    standinAttach(&mcpDevice);
+}
+
+// INT outputs of all chips wired together onto one pin: open drain outputs
+// only pull low, push-pull outputs drive their level
+bool mcpIntLevel()
+{
+    bool level = true;
+    uint8_t i;
+    for (i = 0; i < MAX_CHIPS; i++)
+    {
+        struct mcp_chip *chip = &chips[i];
+        if (!chip->present) continue;
+        checkInterrupts(chip);
+        bool active = chip->regs[REG(INTF)] != 0;
+        uint8_t iocon = chip->regs[REG(IOCON)];
+        if (iocon & IOCON_ODR)
+            level &= !active;
+        else
+            level &= active == ((iocon & IOCON_INTPOL) != 0);
+    }
+    return level;
+}
@@ -0,0 +1,35 @@
+// Virtual DE1-SoC
+// MCP23S08 Model
+// CSE4356-SoC | Fall 2021 | Term Project
+// Deborah Jahaj and Nathan Fusselman
+
+//=============================================================================
+// Hardware Target
+//=============================================================================
+
+// Target Platform: Any Linux host
+
+// MCP23S08 expanders on the SPI bus of the virtual DE1-SoC, attached to the
+// SPI core model as its far-end device. INT of every chip is wired-AND onto
+// GPIO_1[31] as on the board.
+
+//=============================================================================
+
+#ifndef SIM_MCP23S08_H_
+#define SIM_MCP23S08_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//=============================================================================
+// Subroutines
+//=============================================================================
+
+// chips: bit CS * 4 + A1:A0 per expander present
+// inputs: level driven onto the pins of every chip
+// walkMs: when non-zero, a walking one is XORed onto the inputs every walkMs
+void mcpInit(uint16_t chips, uint8_t inputs, uint32_t walkMs);
+void mcpAttach();
+bool mcpIntLevel();
+
+#endif
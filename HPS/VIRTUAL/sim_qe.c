@@ -0,0 +1,109 @@
+// Virtual DE1-SoC
+// QE IP Model
+// CSE4356-SoC | Fall 2021 | Term Project
+// Deborah Jahaj and Nathan Fusselman
+
+//=============================================================================
+// Hardware Target
+//=============================================================================
+
+// Target Platform: Any Linux host
+
+// CONTROL bit n enables channel n and bit n+2 swaps its A and B inputs
+// (reversing the count direction). Position counts at the configured rate
+// while enabled and can be written; velocity is the count over one PERIOD
+// of the 50 MHz clock, 0 until a period is set.
+
+//=============================================================================
+
+#include <stdint.h>                 // C99 integer types -- uint32_t
+#include <stdbool.h>                // bool
+#include <time.h>                   // clock_gettime
+#include "../QE/qe_regs.h"          // registers
+#include "sim_qe.h"                 // qe model
+
+#define SYSTEM_CLOCK 50000000
+
+//=============================================================================
+// Global variables
+//=============================================================================
+
+uint32_t qeControl = 0;
+uint32_t qePeriod = 0;
+double qePosition[2] = {0, 0};
+int32_t qeRate = 0;
+double qeLastUpdate = 0;
+
+//=============================================================================
+// Subroutines
+//=============================================================================
+
+static double nowSeconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int32_t direction(uint8_t channel)
+{
+    return (qeControl & (4 << channel)) ? -1 : 1;
+}
+
+static void updatePositions()
+{
+    double now = nowSeconds();
+    uint8_t channel;
+    for (channel = 0; channel < 2; channel++)
+        if (qeControl & (1 << channel))
+            qePosition[channel] += direction(channel) * qeRate * (now - qeLastUpdate);
+    qeLastUpdate = now;
+}
+
+void qeSimInit(int32_t rate)
+{
+    qeControl = 0;
+    qePeriod = 0;
+    qePosition[0] = qePosition[1] = 0;
+    qeRate = rate;
+    qeLastUpdate = nowSeconds();
+}
+
+uint32_t qeSimRead(uint8_t ofs)
+{
+    updatePositions();
+    switch (ofs)
+    {
+        case OFS_CONTROL:
+            return qeControl;
+        case OFS_PERIOD:
+            return qePeriod;
+        case OFS_POSITION0:
+        case OFS_POSITION1:
+            return (int32_t)qePosition[(ofs - OFS_POSITION0) / 2];
+        case OFS_VELOCITY0:
+        case OFS_VELOCITY1:
+            if (!(qeControl & (1 << ((ofs - OFS_VELOCITY0) / 2)))) return 0;
+            return (int32_t)((double)direction((ofs - OFS_VELOCITY0) / 2) * qeRate
+                             * qePeriod / SYSTEM_CLOCK);
+    }
+    return 0;
+}
+
+void qeSimWrite(uint8_t ofs, uint32_t data)
+{
+    updatePositions();
+    switch (ofs)
+    {
+        case OFS_CONTROL:
+            qeControl = data & 0xF;
+            break;
+        case OFS_PERIOD:
+            qePeriod = data;
+            break;
+        case OFS_POSITION0:
+        case OFS_POSITION1:
+            qePosition[(ofs - OFS_POSITION0) / 2] = (int32_t)data;
+            break;
+    }
+}
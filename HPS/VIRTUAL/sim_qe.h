@@ -0,0 +1,30 @@
+// Virtual DE1-SoC
+// QE IP Model
+// CSE4356-SoC | Fall 2021 | Term Project
+// Deborah Jahaj and Nathan Fusselman
+
+//=============================================================================
+// Hardware Target
+//=============================================================================
+
+// Target Platform: Any Linux host
+
+// QE IP core with an encoder turning at a fixed rate on each channel
+
+//=============================================================================
+
+#ifndef SIM_QE_H_
+#define SIM_QE_H_
+
+#include <stdint.h>
+
+//=============================================================================
+// Subroutines
+//=============================================================================
+
+// rate: counts per second seen by both channels while enabled
+void qeSimInit(int32_t rate);
+uint32_t qeSimRead(uint8_t ofs);
+void qeSimWrite(uint8_t ofs, uint32_t data);
+
+#endif
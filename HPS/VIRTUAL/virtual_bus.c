@@ -0,0 +1,114 @@
+// Virtual DE1-SoC
+// Virtual Light-Weight Bus
+// CSE4356-SoC | Fall 2021 | Term Project
+// Deborah Jahaj and Nathan Fusselman
+
+//=============================================================================
+// Hardware Target
+//=============================================================================
+
+// Target Platform: Any Linux host
+
+// Client side of the mailbox served by de1soc_sim, linked into the IP
+// libraries when they are built with VIRTUAL_DE1SOC
+
+//=============================================================================
+
+#include <stdint.h>          // C99 integer types -- uint32_t
+#include <stdbool.h>         // bool
+#include <stdlib.h>          // getenv
+#include <fcntl.h>           // O_RDWR
+#include <sched.h>           // sched_yield
+#include <signal.h>          // kill
+#include <errno.h>           // ESRCH
+#include <sys/mman.h>        // shm_open, mmap
+#include <unistd.h>          // close, getpid
+#include "virtual_bus.h"     // mailbox
+
+#define SPINS_BEFORE_YIELD 1000
+
+//=============================================================================
+// Global variables
+//=============================================================================
+
+struct vbus_mailbox *mailbox = NULL;
+
+//=============================================================================
+// Subroutines
+//=============================================================================
+
+// Shared by every library in the process, so only the first call maps
+bool vbusOpen()
+{
+    const char *name = getenv(VBUS_NAME_ENV);
+    struct vbus_mailbox *map;
+
+    if (mailbox != NULL) return true;
+    if (name == NULL) name = VBUS_DEFAULT_NAME;
+
+    int file = shm_open(name, O_RDWR, 0);
+    bool bOK = (file >= 0);
+    if (bOK)
+    {
+        map = mmap(NULL, sizeof(struct vbus_mailbox), PROT_READ | PROT_WRITE, MAP_SHARED,
+                   file, 0);
+        bOK = (map != MAP_FAILED);
+        if (bOK)
+        {
+            bOK = (__atomic_load_n(&map->magic, __ATOMIC_ACQUIRE) == VBUS_MAGIC);
+            if (bOK)
+                mailbox = map;
+            else
+                munmap(map, sizeof(struct vbus_mailbox));
+        }
+        close(file);
+    }
+    return bOK;
+}
+
+// Spins for the lock, taking it over if the process holding it has died
+static void lockMailbox()
+{
+    uint32_t pid = getpid(), owner = 0, spins = 0;
+    while (!__atomic_compare_exchange_n(&mailbox->lock, &owner, pid, false,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    {
+        if (++spins % SPINS_BEFORE_YIELD == 0)
+        {
+            if (kill(owner, 0) < 0 && errno == ESRCH)
+                __atomic_compare_exchange_n(&mailbox->lock, &owner, 0, false,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+            sched_yield();
+        }
+        owner = 0;
+    }
+}
+
+static uint32_t transact(bool write, uint32_t address, uint32_t data)
+{
+    uint32_t request, spins = 0;
+
+    if (mailbox == NULL) return 0;
+    lockMailbox();
+    mailbox->write = write;
+    mailbox->address = address;
+    mailbox->data = data;
+    request = mailbox->request + 1;
+    __atomic_store_n(&mailbox->request, request, __ATOMIC_RELEASE);
+    while (__atomic_load_n(&mailbox->response, __ATOMIC_ACQUIRE) != request)
+        if (++spins % SPINS_BEFORE_YIELD == 0)
+            sched_yield();
+    data = mailbox->data;
+    __atomic_store_n(&mailbox->lock, 0, __ATOMIC_RELEASE);
+    return data;
+}
+
+uint32_t vbusRead(uint32_t address)
+{
+    return transact(false, address, 0);
+}
+
+void vbusWrite(uint32_t address, uint32_t data)
+{
+    transact(true, address, data);
+}
@@ -0,0 +1,58 @@
+// Virtual DE1-SoC
+// Virtual Light-Weight Bus
+// CSE4356-SoC | Fall 2021 | Term Project
+// Deborah Jahaj and Nathan Fusselman
+
+//=============================================================================
+// Hardware Target
+//=============================================================================
+
+// Target Platform: Any Linux host
+
+// Replaces the /dev/mem mapping of the light-weight MM interface aperature
+// when gpio_ip.c, spi_ip.c and qe_ip.c are built with VIRTUAL_DE1SOC.
+// Each register access is posted to a mailbox in a shared memory region
+// and completed by the simulator process (de1soc_sim), which models the
+// register semantics of the IP cores behind the bridge.
+
+//=============================================================================
+
+#ifndef VIRTUAL_BUS_H_
+#define VIRTUAL_BUS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define VBUS_NAME_ENV        "DE1SOC_SHM"    // overrides the region name
+#define VBUS_DEFAULT_NAME    "/de1soc"
+#define VBUS_MAGIC           0xDE150C01
+
+//=============================================================================
+// Shared memory layout
+//=============================================================================
+
+// One access at a time: a client takes lock (holding its pid), fills in the
+// access and bumps request; the simulator performs it, stores any read data
+// and sets response to the same value
+struct vbus_mailbox
+{
+    uint32_t magic;                  // set by the simulator once it is serving
+    uint32_t lock;
+    uint32_t request;
+    uint32_t response;
+    uint32_t write;
+    uint32_t address;                // byte offset in the aperature
+    uint32_t data;
+    uint32_t reserved;
+    uint64_t accesses;               // completed by the simulator
+};
+
+//=============================================================================
+// Subroutines
+//=============================================================================
+
+bool vbusOpen();
+uint32_t vbusRead(uint32_t address);
+void vbusWrite(uint32_t address, uint32_t data);
+
+#endif
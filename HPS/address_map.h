@@ -1,5 +1,8 @@
 #define LW_BRIDGE_BASE         0xFF200000
+#define LW_BRIDGE_SPAN         0x00200000
 
 #define GPIO_BASE_OFFSET       0x00000000
 
-#define SPI_BASE_OFFSET        0x00008000
+#define QE_BASE_OFFSET         0x00001000
+
+#define SPI_BASE_OFFSET        0x00008000
\ No newline at end of file
@@ -0,0 +1,134 @@
+// DE1-SoC
+// Light-Weight Bridge Library
+// CSE4356-SoC | Fall 2021 | Term Project
+// Deborah Jahaj and Nathan Fusselman
+
+//=============================================================================
+// Hardware Target
+//=============================================================================
+
+// Target Platform: DE1-SoC Board
+
+// Hardware configuration:
+// HPS interface:
+//   Light-weight MM interface aperature of LW_BRIDGE_SPAN bytes at
+//   LW_BRIDGE_BASE, shared by every IP core instance of the process
+
+//=============================================================================
+
+#include <stdint.h>          // C99 integer types -- uint32_t
+#include <stdbool.h>         // bool
+#include <string.h>          // strncmp, strncpy
+#include <fcntl.h>           // open
+#include <sys/mman.h>        // mmap
+#include <unistd.h>          // close
+#include "address_map.h"     // address map
+#include "lw_bridge.h"       // lw bridge
+#ifdef VIRTUAL_DE1SOC
+#include "VIRTUAL/virtual_bus.h" // virtual bus
+#endif
+
+#define MAX_CORES 16
+
+struct lw_core
+{
+    char name[LW_CORE_NAME_LENGTH];
+    uint32_t offset;
+};
+
+//=============================================================================
+// Global variables
+//=============================================================================
+
+static uint32_t *bridge = NULL;
+static uint32_t windows = 0;
+
+static struct lw_core cores[MAX_CORES] =
+{
+    {"gpio", GPIO_BASE_OFFSET},
+    {"qe", QE_BASE_OFFSET},
+    {"spi", SPI_BASE_OFFSET},
+};
+static uint8_t coreCount = 3;
+
+//=============================================================================
+// Subroutines
+//=============================================================================
+
+static bool openBridge()
+{
+#ifdef VIRTUAL_DE1SOC
+    return vbusOpen();
+#endif
+
+    // Open /dev/mem
+    int file = open("/dev/mem", O_RDWR | O_SYNC);
+    bool bOK = (file >= 0);
+    if (bOK)
+    {
+        // Create a map from the physical memory location of
+        // /dev/mem at the LW avalon interface
+        // with an aperature of LW_BRIDGE_SPAN bytes
+        // to any location in the virtual 32-bit memory space of the process
+        bridge = mmap(NULL, LW_BRIDGE_SPAN, PROT_READ | PROT_WRITE, MAP_SHARED,
+                      file, LW_BRIDGE_BASE);
+        bOK = (bridge != MAP_FAILED);
+        if (!bOK) bridge = NULL;
+
+        // Close /dev/mem
+        close(file);
+    }
+    return bOK;
+}
+
+bool lwBridgeMap(uint32_t offset, uint32_t span, uint32_t **base)
+{
+    if ((offset & 0x3) || span > LW_BRIDGE_SPAN || offset > LW_BRIDGE_SPAN - span)
+        return false;
+    if (windows == 0 && !openBridge())
+        return false;
+    windows++;
+    *base = bridge ? bridge + offset / 4 : NULL;
+    return true;
+}
+
+void lwBridgeUnmap()
+{
+    if (windows == 0) return;
+    if (--windows == 0 && bridge)
+    {
+        munmap(bridge, LW_BRIDGE_SPAN);
+        bridge = NULL;
+    }
+}
+
+static struct lw_core *findCore(const char *name)
+{
+    uint8_t i;
+    for (i = 0; i < coreCount; i++)
+        if (strncmp(cores[i].name, name, LW_CORE_NAME_LENGTH) == 0)
+            return &cores[i];
+    return NULL;
+}
+
+bool lwBridgeAddCore(const char *name, uint32_t offset)
+{
+    struct lw_core *core = findCore(name);
+    if (strlen(name) >= LW_CORE_NAME_LENGTH || offset >= LW_BRIDGE_SPAN) return false;
+    if (core == NULL)
+    {
+        if (coreCount == MAX_CORES) return false;
+        core = &cores[coreCount++];
+        strncpy(core->name, name, LW_CORE_NAME_LENGTH);
+    }
+    core->offset = offset;
+    return true;
+}
+
+bool lwBridgeFindCore(const char *name, uint32_t *offset)
+{
+    struct lw_core *core = findCore(name);
+    if (core == NULL) return false;
+    *offset = core->offset;
+    return true;
+}
@@ -0,0 +1,54 @@
+// DE1-SoC
+// Light-Weight Bridge Library
+// CSE4356-SoC | Fall 2021 | Term Project
+// Deborah Jahaj and Nathan Fusselman
+
+//=============================================================================
+// Hardware Target
+//=============================================================================
+
+// Target Platform: DE1-SoC Board
+
+// Maps the light-weight MM interface aperature once per process and hands
+// out the register windows of the IP cores behind it, so gpio_ip.c,
+// spi_ip.c and qe_ip.c can be linked into one program and open any number
+// of instances. Programs using those libraries link this file as well.
+// Built with VIRTUAL_DE1SOC the bridge is the virtual bus to de1soc_sim.
+
+// Opening and closing are not thread safe; open every instance before
+// starting threads that use them.
+
+//=============================================================================
+
+#ifndef LW_BRIDGE_H_
+#define LW_BRIDGE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define LW_CORE_NAME_LENGTH  16
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//=============================================================================
+// Subroutines
+//=============================================================================
+
+// Maps the bridge on first use and returns the window of span bytes at
+// offset (NULL under VIRTUAL_DE1SOC, where accesses go by offset instead)
+bool lwBridgeMap(uint32_t offset, uint32_t span, uint32_t **base);
+// Releases one window, unmapping the bridge with the last one
+void lwBridgeUnmap();
+
+// Table of core offsets, starting with "gpio", "qe" and "spi" at their
+// address_map.h offsets; adding a name that exists moves it
+bool lwBridgeAddCore(const char *name, uint32_t offset);
+bool lwBridgeFindCore(const char *name, uint32_t *offset);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,164 @@
+// DE1-SoC
+// Register Field Templates
+// CSE4356-SoC | Fall 2021 | Term Project
+// Deborah Jahaj and Nathan Fusselman
+
+//=============================================================================
+// Hardware Target
+//=============================================================================
+
+// Target Platform: DE1-SoC Board (C++11 or later)
+
+// Register<Core, Offset> and Field<Reg, Lsb, Width> describe the register
+// map of an IP core as types (spi_regs.hpp, gpio_regs.hpp, qe_regs.hpp);
+// Core is a tag type declared once per core, so registers at the same
+// offset of different cores are different types. Field
+// values of one register combine with | into a RegisterValue, folded to a
+// mask and bits at compile time, so any number of field updates is:
+//   write   one store, fields not given are 0
+//   update  one store, starting from a shadow of the register
+//   modify  one load and one store
+// Values of fields of different registers, or of different cores, do not
+// combine.
+// base is the window of the core, e.g. from lwBridgeMap(); the accesses are
+// plain volatile loads and stores, so this is for the hardware build only.
+
+//=============================================================================
+
+#ifndef MMIO_REG_HPP_
+#define MMIO_REG_HPP_
+
+#include <stdint.h>
+
+namespace mmio
+{
+
+//=============================================================================
+// Register values
+//=============================================================================
+
+template <typename Reg>
+struct RegisterValue
+{
+    uint32_t mask;           // bits set by the fields
+    uint32_t bits;
+
+    constexpr RegisterValue operator|(RegisterValue other) const
+    {
+        return RegisterValue{mask | other.mask, bits | other.bits};
+    }
+
+    constexpr uint32_t apply(uint32_t value) const
+    {
+        return (value & ~mask) | bits;
+    }
+};
+
+//=============================================================================
+// Registers
+//=============================================================================
+
+// Offset in words from the base of the core; Core only tells the cores
+// apart and is never defined
+template <typename Core, uint32_t Offset>
+struct Register
+{
+    typedef Core core;
+    typedef RegisterValue<Register> value_type;
+    static constexpr uint32_t offset = Offset;
+
+    static uint32_t read(volatile uint32_t *base)
+    {
+        return base[Offset];
+    }
+
+    static void write(volatile uint32_t *base, uint32_t value)
+    {
+        base[Offset] = value;
+    }
+
+    static void write(volatile uint32_t *base, value_type value)
+    {
+        base[Offset] = value.bits;
+    }
+
+    static void update(volatile uint32_t *base, uint32_t &shadow, value_type value)
+    {
+        shadow = value.apply(shadow);
+        base[Offset] = shadow;
+    }
+
+    static void modify(volatile uint32_t *base, value_type value)
+    {
+        base[Offset] = value.apply(base[Offset]);
+    }
+};
+
+//=============================================================================
+// Fields
+//=============================================================================
+
+template <typename Reg, unsigned Lsb, unsigned Width>
+struct Field
+{
+    static_assert(Width >= 1 && Lsb + Width <= 32, "field outside the register");
+
+    typedef Reg reg;
+    static constexpr uint32_t mask = (Width == 32) ? 0xFFFFFFFFu : ((1u << Width) - 1) << Lsb;
+
+    // Values wider than the field are truncated, as in the C library
+    static constexpr RegisterValue<Reg> of(uint32_t value)
+    {
+        return RegisterValue<Reg>{mask, (value << Lsb) & mask};
+    }
+
+    static constexpr uint32_t get(uint32_t regValue)
+    {
+        return (regValue & mask) >> Lsb;
+    }
+
+    static uint32_t read(volatile uint32_t *base)
+    {
+        return get(Reg::read(base));
+    }
+};
+
+// Count fields of Width bits, Stride bits apart (one per chip select or
+// channel); an index out of range gives a value that changes nothing
+template <typename Reg, unsigned Lsb, unsigned Width, unsigned Stride, unsigned Count>
+struct FieldArray
+{
+    static_assert(Width >= 1 && Width < 32 && Lsb + (Count - 1) * Stride + Width <= 32,
+                  "field outside the register");
+
+    typedef Reg reg;
+
+    template <unsigned Index>
+    using Element = Field<Reg, Lsb + Index * Stride, Width>;
+
+    static constexpr uint32_t mask(unsigned index)
+    {
+        return (index < Count) ? ((1u << Width) - 1) << (Lsb + index * Stride) : 0;
+    }
+
+    static constexpr RegisterValue<Reg> at(unsigned index, uint32_t value)
+    {
+        return (index < Count)
+            ? RegisterValue<Reg>{mask(index), (value << (Lsb + index * Stride)) & mask(index)}
+            : RegisterValue<Reg>{0, 0};
+    }
+
+    static constexpr uint32_t get(uint32_t regValue, unsigned index)
+    {
+        return (index < Count) ? (regValue & mask(index)) >> (Lsb + index * Stride) : 0;
+    }
+
+    static uint32_t read(volatile uint32_t *base, unsigned index)
+    {
+        return get(Reg::read(base), index);
+    }
+};
+
+}
+
+#endif